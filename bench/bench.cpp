@@ -0,0 +1,234 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <unistd.h>
+
+#include "misc.hpp"
+#include "file.hpp"
+#include "lex.hpp"
+#include "pp.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+// Generates synthetic inputs and reports the throughput of lex(),
+// preprocess() and convert_lexemes() on each, one JSON object per line.
+// The lex phase lexes every group; preprocess() is given the file lexed
+// lazily, as the compiler gives it, so its time includes skipping the
+// inactive groups.
+//
+// usage: ./build/bench [size in KB] [repetitions]
+//
+// Run it from the repository root: the many-include input uses the headers
+// in include/, which the preprocessor finds relative to the working
+// directory.
+
+namespace {
+    size_t target_size = 64 << 10;
+    int reps = 3;
+
+    _ write_file(const str& path, const str& text) {
+        _ os = std::ofstream(path);
+        os << text;
+    }
+
+    str gen_comments() {
+        std::ostringstream os;
+        for (_ i = 0; size_t(os.tellp()) < target_size; i++) {
+            os << "/*\n";
+            for (_ j = 0; j < 8; j++) {
+                os << " * block comment line " << j
+                   << " with some words in it, and more words after that\n";
+            }
+            os << " */\n";
+            os << "int v" << i << "; // a trailing comment for v" << i << "\n";
+            os << "        \t  \n";
+        }
+        return os.str();
+    }
+
+    str gen_macro_chain() {
+        const _ depth = 16;
+        std::ostringstream os;
+        os << "#define M0(x) ((x) + 1)\n";
+        for (_ i = 1; i < depth; i++) {
+            os << "#define M" << i << "(x) M" << i - 1 << "((x) * " << i
+               << ")\n";
+        }
+        os << "#define LEAF(a, b) M4(a) + M3(b)\n";
+        for (_ i = 0; size_t(os.tellp()) < target_size; i++) {
+            os << "int c" << i << " = M" << i % depth << "(" << i
+               << ") + LEAF(c" << i / 2 << ", " << i << ");\n";
+        }
+        return os.str();
+    }
+
+    // a single line whose expansion is a long X-macro style table
+    str gen_long_line() {
+        std::ostringstream os;
+        os << "#define ROW(n) {n, n + 1, -n},\n";
+        os << "#define ROWS(n) ROW(n) ROW(n + 1) ROW(n + 2) ROW(n + 3)\n";
+        os << "int table[][3] = {";
+        for (_ i = 0; size_t(os.tellp()) < target_size; i++) {
+            os << " ROWS(" << 4 * i << ")";
+        }
+        os << " };\n";
+        return os.str();
+    }
+
+    str gen_if_tree() {
+        std::ostringstream os;
+        for (_ i = 0; i < 64; i++) {
+            if (i % 3 == 0) {
+                os << "#define F" << i << " " << i << "\n";
+            }
+        }
+        for (_ i = 0; size_t(os.tellp()) < target_size; i++) {
+            _ a = i % 64;
+            _ b = (i * 7) % 64;
+            os << "#if defined(F" << a << ") && F" << a << " > 10\n";
+            os << "int t" << i << " = F" << a << ";\n";
+            os << "#elif defined F" << b << "\n";
+            os << "#  if F" << b << " % 2\n";
+            os << "int u" << i << " = 1;\n";
+            os << "#  else\n";
+            os << "int u" << i << " = 2;\n";
+            os << "#  endif\n";
+            os << "#else\n";
+            os << "#  ifdef F" << (a + 1) % 64 << "\n";
+            os << "int w" << i << ";\n";
+            os << "#  endif\n";
+            os << "#endif\n";
+        }
+        return os.str();
+    }
+
+    str gen_include_tree(const str& dir) {
+        const _ n = 255;
+        for (_ i = 0; i < n; i++) {
+            std::ostringstream os;
+            os << "#ifndef H" << i << "\n";
+            os << "#define H" << i << "\n";
+            for (_ c : {2 * i + 1, 2 * i + 2}) {
+                if (c < n) {
+                    os << "#include \"h" << c << ".h\"\n";
+                }
+            }
+            os << "#include <stddef.h>\n";
+            os << "#include <stdarg.h>\n";
+            os << "#include <stdbool.h>\n";
+            for (_ j = 0; j < 16; j++) {
+                os << "typedef size_t h" << i << "_t" << j << ";\n";
+            }
+            os << "#endif\n";
+            write_file(dir + "/h" + std::to_string(i) + ".h", os.str());
+        }
+        std::ostringstream os;
+        for (_ i = 0; size_t(os.tellp()) < target_size / 16; i++) {
+            os << "#include \"h" << i % n << ".h\"\n";
+            os << "bool b" << i << " = true;\n";
+        }
+        return os.str();
+    }
+
+    template <class t_fn>
+    double seconds(t_fn fn) {
+        _ start = std::chrono::steady_clock::now();
+        fn();
+        _ end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    template <class t_fn>
+    double best_time(t_fn fn) {
+        _ best = 0.0;
+        for (_ i = 0; i < reps; i++) {
+            _ t = seconds(fn);
+            if (i == 0 or t < best) {
+                best = t;
+            }
+        }
+        return best;
+    }
+
+    void report(const str& input, const str& phase, size_t bytes,
+                size_t tokens, double seconds) {
+        cout << "{\"input\": \"" << input << "\", \"phase\": \"" << phase
+             << "\", \"bytes\": " << bytes << ", \"tokens\": " << tokens
+             << ", \"seconds\": " << seconds
+             << ", \"mb_per_s\": " << bytes / seconds / 1e6
+             << ", \"tokens_per_s\": " << tokens / seconds << "}\n";
+    }
+
+    void bench(const str& input, const str& path) {
+        _ fm = t_file_manager();
+        _ idx = fm.read_file(path);
+        _ bytes = fm.get_file_contents(idx).size();
+
+        _ lexed = t_pp_seq();
+        _ lex_time = best_time([&]() {
+            lexed = lex(idx, fm);
+        });
+        report(input, "lex", bytes, lexed.size(), lex_time);
+
+        _ pp_ls = t_pp_seq();
+        _ pp_time = 0.0;
+        for (_ i = 0; i < reps; i++) {
+            // lexed as the compiler does, leaving inactive groups as raw
+            // text for the preprocessor to skip
+            _ ls = lex(idx, fm, true);
+            _ t = seconds([&]() {
+                preprocess(ls, fm);
+            });
+            if (i == 0 or t < pp_time) {
+                pp_time = t;
+            }
+            pp_ls = std::move(ls);
+        }
+        report(input, "preprocess", bytes, pp_ls.size(), pp_time);
+
+        _ converted = vec<t_lexeme>();
+        _ convert_time = best_time([&]() {
+            converted = convert_lexemes(pp_ls.begin(), pp_ls.end());
+        });
+        report(input, "convert_lexemes", bytes, converted.size(),
+               convert_time);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        target_size = std::stoul(argv[1]) * 1024;
+    }
+    if (argc > 2) {
+        reps = std::stoi(argv[2]);
+    }
+    str dir_template = fs::temp_directory_path().string() + "/bench-XXXXXX";
+    if (mkdtemp(dir_template.data()) == nullptr) {
+        std::cerr << "error: could not create a temporary directory\n";
+        return 1;
+    }
+    _ dir = dir_template;
+    _ inputs = vec<std::pair<str, str>>{
+        {"comments", gen_comments()},
+        {"macro_chain", gen_macro_chain()},
+        {"long_line", gen_long_line()},
+        {"if_tree", gen_if_tree()},
+        {"include_tree", gen_include_tree(dir)},
+    };
+    _ status = 0;
+    for (_& [name, text] : inputs) {
+        _ path = dir + "/" + name + ".c";
+        write_file(path, text);
+        try {
+            bench(name, path);
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << name << ": " << e.what() << "\n";
+            status = 1;
+        }
+    }
+    fs::remove_all(dir);
+    return status;
+}
@@ -11,17 +11,17 @@
 #include "lex.hpp"
 #include "gen.hpp"
 
-extern const vec<str> simple_type_specifiers = {
-    "void", "char", "short", "int", "long", "float", "double",
-    "signed", "unsigned"
+extern const vec<t_kind> simple_type_specifiers = {
+    t_kind::_void, t_kind::_char, t_kind::_short, t_kind::_int, t_kind::_long,
+    t_kind::_float, t_kind::_double, t_kind::_signed, t_kind::_unsigned
 };
 
 using t_rule = bool(bool);
 using t_dyn_rule = std::function<bool(bool)>;
 
 class t_ast_ctx {
-    vec<std::unordered_map<str, bool>> typedef_names;
-    std::list<t_lexeme>::const_iterator pos;
+    vec<std::unordered_map<t_id, bool>> typedef_names;
+    vec<t_lexeme>::const_iterator pos;
     std::stack<str> rule_names;
     std::stack<t_ast*> node_ptrs;
     t_ast result;
@@ -29,7 +29,7 @@ class t_ast_ctx {
 public:
     t_ast_ctx() {
     }
-    void init(std::list<t_lexeme>::const_iterator start) {
+    void init(vec<t_lexeme>::const_iterator start) {
         typedef_names.clear();
         typedef_names.push_back({});
         pos = start;
@@ -44,10 +44,10 @@ public:
     void leave_scope() {
         typedef_names.pop_back();
     }
-    void put(const str& id, bool x) {
-        typedef_names.back()[id] = x;
+    void put(const str& name, bool x) {
+        typedef_names.back()[intern(name)] = x;
     }
-    bool is_typedef_name(const str& id) {
+    bool is_typedef_name(t_id id) {
         for (_ i = typedef_names.size(); i > 0; i--) {
             _ x = typedef_names[i-1].find(id);
             if (x != typedef_names[i-1].end()) {
@@ -60,7 +60,7 @@ public:
         return *pos;
     }
     void advance(int n = 1) {
-        if ((*pos).uu != "eof") {
+        if ((*pos).uu != t_kind::eof) {
             std::advance(pos, n);
         }
     }
@@ -70,9 +70,9 @@ public:
         }
         return rule_names.top();
     }
-    void add_leaf(const str& kind, const str& val) {
+    void add_leaf(str_view kind, str_view val) {
         assert(m_cur_node != nullptr);
-        (*m_cur_node).add_child(t_ast(kind, val, peek().loc));
+        (*m_cur_node).add_child(t_ast(str(kind), str(val), peek().loc));
     }
     void enter_rule(const str& name) {
         // cout << "enter " << name << "\n";
@@ -123,9 +123,9 @@ namespace {
 
     _& peek() { return ctx.peek(); }
     _ advance(int n = 1) { ctx.advance(n); }
-    _ cmp(const str& name) { return peek().uu == name; }
+    _ cmp(t_kind kind) { return peek().uu == kind; }
 
-    bool syms_0(const char* sym) {
+    bool syms_0(t_kind sym) {
         if (cmp(sym)) {
             advance();
             return true;
@@ -141,7 +141,7 @@ namespace {
         return sym(false);
     }
 
-    bool apply_sym(bool only_check, const char* sym) {
+    bool apply_sym(bool only_check, t_kind sym) {
         if (only_check) {
             return cmp(sym);
         } else {
@@ -289,7 +289,7 @@ namespace {
             }
             syms_(ss ...);
             while (true) {
-                if (not cmp(",")) {
+                if (not cmp(t_kind::comma)) {
                     break;
                 }
                 advance();
@@ -335,9 +335,9 @@ namespace {
 
     bool identifier(bool only_check) {
         if (only_check) {
-            return cmp("identifier");
+            return cmp(t_kind::identifier);
         }
-        if (cmp("identifier")) {
+        if (cmp(t_kind::identifier)) {
             ctx.add_leaf("identifier", peek().vv);
             advance();
             return true;
@@ -356,13 +356,15 @@ namespace {
     bool prim_exp_0(bool only_check) {
         _ kind = peek().uu;
         _ val = peek().vv;
-        if ((kind == "identifier" and not ctx.is_typedef_name(val))
-            or kind == "integer_constant" or kind == "floating_constant"
-            or kind == "char_constant" or kind == "string_literal") {
+        if ((kind == t_kind::identifier and not ctx.is_typedef_name(peek().id))
+            or kind == t_kind::integer_constant
+            or kind == t_kind::floating_constant
+            or kind == t_kind::char_constant
+            or kind == t_kind::string_literal) {
             if (only_check) {
                 return true;
             }
-            ctx.add_leaf(kind, val);
+            ctx.add_leaf(kind_name(kind), val);
             advance();
             return true;
         } else {
@@ -371,7 +373,7 @@ namespace {
     }
 
     bool type_name_in_parens(bool only_check) {
-        if (not cmp("(")) {
+        if (not cmp(t_kind::lparen)) {
             return false;
         }
         advance();
@@ -383,11 +385,11 @@ namespace {
         if (only_check) {
             return true;
         }
-        syms_("(", type_name, ")");
+        syms_(t_kind::lparen, type_name, t_kind::rparen);
         return true;
     }
 
-    _ left_assoc_op(const vec<str>& ops, _ e) {
+    _ left_assoc_op(const vec<t_kind>& ops, _ e) {
         _ ff = [=](bool only_check) {
             _ x = check(e);
             if (not x) {
@@ -403,7 +405,7 @@ namespace {
                     break;
                 }
                 advance();
-                ctx.enter_rule(op);
+                ctx.enter_rule(str(kind_name(op)));
                 ctx.replace_node();
                 syms_(e);
                 ctx.leave_node();
@@ -421,14 +423,14 @@ namespace {
         if (only_check) {
             return true;
         }
-        ctx.add_leaf("simple_type_spec", peek().uu);
+        ctx.add_leaf("simple_type_spec", kind_name(peek().uu));
         advance();
         return true;
     }
 
     bool typedef_name(bool only_check) {
         ctx.enter_rule(__func__);
-        if (not (cmp("identifier") and ctx.is_typedef_name(peek().vv))) {
+        if (not (cmp(t_kind::identifier) and ctx.is_typedef_name(peek().id))) {
             ctx.leave_rule();
             return false;
         }
@@ -444,14 +446,15 @@ namespace {
     }
 
     bool storage_class_specifier(bool only_check) {
-        if (not (cmp("static") or cmp("extern") or cmp("register")
-                 or cmp("auto") or cmp("typedef"))) {
+        if (not (cmp(t_kind::_static) or cmp(t_kind::_extern)
+                 or cmp(t_kind::_register) or cmp(t_kind::_auto)
+                 or cmp(t_kind::_typedef))) {
             return false;
         }
         if (only_check) {
             return true;
         }
-        ctx.add_leaf("storage_class_specifier", peek().uu);
+        ctx.add_leaf("storage_class_specifier", kind_name(peek().uu));
         advance();
         return true;
     }
@@ -497,7 +500,8 @@ namespace {
     bool compound_stmt(bool only_check) {
         ctx.enter_scope();
         _ res = apply_rule(only_check, __func__,
-                           "{", opt(seq(block_item)), "}");
+                           t_kind::lbrace, opt(seq(block_item)),
+                           t_kind::rbrace);
         ctx.leave_scope();
         return res;
     }
@@ -513,16 +517,16 @@ namespace {
         syms_(decl_specs);
         _ is_typedef = (storage_class(ctx.last_child())
                         == t_storage_class::_typedef);
-        if (not cmp(";")) {
+        if (not cmp(t_kind::semicolon)) {
             while (true) {
                 syms_(init_decltor);
                 ctx.put(find_id(ctx.last_child()), is_typedef);
-                if (not syms(",")) {
+                if (not syms(t_kind::comma)) {
                     break;
                 }
             }
         }
-        syms_(bar(";", compound_stmt));
+        syms_(bar(t_kind::semicolon, compound_stmt));
         ctx.leave_node();
         ctx.leave_rule();
         return true;
@@ -530,12 +534,12 @@ namespace {
 
     bool label_stmt(bool only_check) {
         ctx.enter_rule(__func__);
-        if (not cmp("identifier")) {
+        if (not cmp(t_kind::identifier)) {
             ctx.leave_rule();
             return false;
         }
         advance();
-        if (not cmp(":")) {
+        if (not cmp(t_kind::colon)) {
             advance(-1);
             ctx.leave_rule();
             return false;
@@ -546,7 +550,7 @@ namespace {
             return true;
         }
         ctx.create_node();
-        syms_(identifier, ":", stmt);
+        syms_(identifier, t_kind::colon, stmt);
         ctx.leave_node();
         ctx.leave_rule();
         return true;
@@ -577,11 +581,11 @@ namespace {
             return true;
         }
         syms_(or_exp);
-        if (cmp("?")) {
+        if (cmp(t_kind::question)) {
             ctx.enter_rule("?:");
             ctx.replace_node();
             advance();
-            syms_(subexp, ":", cond_exp);
+            syms_(subexp, t_kind::colon, cond_exp);
             ctx.leave_node();
             ctx.leave_rule();
         }
@@ -595,8 +599,11 @@ namespace {
         if (only_check) {
             return true;
         }
-        const _ assign_ops = vec<str>{
-            "=", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=", "&=", "^=", "|="
+        const _ assign_ops = vec<t_kind>{
+            t_kind::assign, t_kind::mul_assign, t_kind::div_assign,
+            t_kind::mod_assign, t_kind::add_assign, t_kind::sub_assign,
+            t_kind::shl_assign, t_kind::shr_assign, t_kind::and_assign,
+            t_kind::xor_assign, t_kind::or_assign
         };
         syms_(cond_exp);
         _ n = 0;
@@ -605,7 +612,7 @@ namespace {
             if (not has(assign_ops, op)) {
                 break;
             }
-            ctx.enter_rule(op);
+            ctx.enter_rule(str(kind_name(op)));
             ctx.replace_node();
             advance();
             syms_(cond_exp);
@@ -630,32 +637,34 @@ namespace {
     }
 
     def_aux(prim_exp,
-            bar(prim_exp_0, __("(", subexp, ")")));
+            bar(prim_exp_0, __(t_kind::lparen, subexp, t_kind::rparen)));
 
     def_aux(cast_exp, bar(cast, un_exp));
-    def_aux(mul_exp, left_assoc_op({"*", "/", "%"}, cast_exp));
-    def_aux(add_exp, left_assoc_op({"+", "-"},  mul_exp));
-    def_aux(shift_exp, left_assoc_op({"<<", ">>"}, add_exp));
-    def_aux(rel_exp, left_assoc_op({"<", ">", "<=", ">="}, shift_exp));
-    def_aux(eql_exp, left_assoc_op({"==", "!="}, rel_exp));
-    def_aux(bit_and_exp, left_assoc_op({"&"}, eql_exp));
-    def_aux(bit_xor_exp, left_assoc_op({"^"}, bit_and_exp));
-    def_aux(bit_or_exp, left_assoc_op({"|"}, bit_xor_exp));
-    def_aux(and_exp, left_assoc_op({"&&"}, bit_or_exp));
-    def_aux(or_exp, left_assoc_op({"||"}, and_exp));
+    def_aux(mul_exp, left_assoc_op({t_kind::star, t_kind::slash,
+                                    t_kind::percent}, cast_exp));
+    def_aux(add_exp, left_assoc_op({t_kind::plus, t_kind::minus},  mul_exp));
+    def_aux(shift_exp, left_assoc_op({t_kind::shl, t_kind::shr}, add_exp));
+    def_aux(rel_exp, left_assoc_op({t_kind::lt, t_kind::gt,
+                                    t_kind::le, t_kind::ge}, shift_exp));
+    def_aux(eql_exp, left_assoc_op({t_kind::eq, t_kind::ne}, rel_exp));
+    def_aux(bit_and_exp, left_assoc_op({t_kind::amp}, eql_exp));
+    def_aux(bit_xor_exp, left_assoc_op({t_kind::caret}, bit_and_exp));
+    def_aux(bit_or_exp, left_assoc_op({t_kind::bit_or}, bit_xor_exp));
+    def_aux(and_exp, left_assoc_op({t_kind::log_and}, bit_or_exp));
+    def_aux(or_exp, left_assoc_op({t_kind::log_or}, and_exp));
 
     def_l(array_subscript,
-          "[", subexp, "]");
+          t_kind::lbracket, subexp, t_kind::rbracket);
     def_l(func_call,
-          "(", opt(comma_seq(assign_exp)), ")");
+          t_kind::lparen, opt(comma_seq(assign_exp)), t_kind::rparen);
     def_l(member,
-          ".", identifier);
+          t_kind::dot, identifier);
     def_l(arrow,
-          "->", identifier);
+          t_kind::arrow, identifier);
     def_l(postfix_inc,
-          "++");
+          t_kind::inc);
     def_l(postfix_dec,
-          "--");
+          t_kind::dec);
     def_aux(postfix_exp,
             prim_exp, opt(seq(bar(array_subscript,
                                   func_call,
@@ -665,24 +674,24 @@ namespace {
                                   postfix_dec))));
 
     def(adr_op,
-        "&", cast_exp);
+        t_kind::amp, cast_exp);
     def(ind_op,
-        "*", cast_exp);
+        t_kind::star, cast_exp);
     def(un_plus,
-        "+", cast_exp);
+        t_kind::plus, cast_exp);
     def(un_minus,
-        "-", cast_exp);
+        t_kind::minus, cast_exp);
     def(bit_not_op,
-        "~", cast_exp);
+        t_kind::tilde, cast_exp);
     def(not_op,
-        "!", cast_exp);
+        t_kind::log_not, cast_exp);
     def(prefix_inc,
-        "++", un_exp);
+        t_kind::inc, un_exp);
     def(prefix_dec,
-        "--", un_exp);
+        t_kind::dec, un_exp);
     def(sizeof_op,
-        "sizeof", bar(type_name_in_parens,
-                      un_exp));
+        t_kind::_sizeof, bar(type_name_in_parens,
+                             un_exp));
     def_aux(un_exp,
             bar(postfix_exp,
                 prefix_inc,
@@ -695,24 +704,24 @@ namespace {
                 not_op,
                 sizeof_op));
 
-    def_aux(subexp, left_assoc_op({","}, assign_exp));
+    def_aux(subexp, left_assoc_op({t_kind::comma}, assign_exp));
     def(exp, subexp);
     def(const_exp, cond_exp);
 
     def_aux(opt_id, bar(identifier, empty_identifier));
 
     def_l(array_decltor,
-          "[", opt(const_exp), "]");
+          t_kind::lbracket, opt(const_exp), t_kind::rbracket);
     def_l(func_decltor,
-          "(", opt(param_types), ")");
+          t_kind::lparen, opt(param_types), t_kind::rparen);
     def_aux(direct_decltor,
-            bar(__("(", decltor, ")"),
+            bar(__(t_kind::lparen, decltor, t_kind::rparen),
                 identifier,
                 empty_identifier),
             opt(seq(bar(array_decltor,
                         func_decltor))));
     def(ptr_decltor,
-        "*", decltor);
+        t_kind::star, decltor);
     def_aux(decltor,
             bar(ptr_decltor, direct_decltor));
 
@@ -721,65 +730,70 @@ namespace {
     def(param_decl,
         decl_specs, decltor);
     def(ellipsis,
-        "...");
+        t_kind::ellipsis);
     def(param_types,
-        comma_seq(param_decl), opt(",", ellipsis));
+        comma_seq(param_decl), opt(t_kind::comma, ellipsis));
 
     def(if_stmt,
-        "if", "(", exp, ")", stmt, opt("else", stmt));
+        t_kind::_if, t_kind::lparen, exp, t_kind::rparen, stmt,
+        opt(t_kind::_else, stmt));
     def(opt_exp,
         opt(exp));
     def(for_stmt,
-        "for", "(", bar(declaration, __(opt_exp, ";")),
-        opt_exp, ";", opt_exp, ")", stmt);
+        t_kind::_for, t_kind::lparen,
+        bar(declaration, __(opt_exp, t_kind::semicolon)),
+        opt_exp, t_kind::semicolon, opt_exp, t_kind::rparen, stmt);
     def(break_stmt,
-        "break", ";");
+        t_kind::_break, t_kind::semicolon);
     def(continue_stmt,
-        "continue", ";");
+        t_kind::_continue, t_kind::semicolon);
     def(switch_stmt,
-        "switch", "(", exp, ")", stmt);
+        t_kind::_switch, t_kind::lparen, exp, t_kind::rparen, stmt);
     def(case_stmt,
-        "case", const_exp, ":", stmt);
+        t_kind::_case, const_exp, t_kind::colon, stmt);
     def(goto_stmt,
-        "goto", identifier, ";");
+        t_kind::_goto, identifier, t_kind::semicolon);
     def(default_stmt,
-        "default", ":", stmt);
+        t_kind::_default, t_kind::colon, stmt);
     def(do_while_stmt,
-        "do", stmt, "while", "(", exp, ")", ";");
+        t_kind::_do, stmt, t_kind::_while,
+        t_kind::lparen, exp, t_kind::rparen, t_kind::semicolon);
     def(while_stmt,
-        "while", "(", exp, ")", stmt);
+        t_kind::_while, t_kind::lparen, exp, t_kind::rparen, stmt);
     def(return_stmt,
-        "return", opt(exp), ";");
+        t_kind::_return, opt(exp), t_kind::semicolon);
     def(exp_stmt,
-        bar(";", __(exp, ";")));
+        bar(t_kind::semicolon, __(exp, t_kind::semicolon)));
 
     def(struct_decltors,
         comma_seq(decltor));
     def(struct_decl,
-        decl_specs, struct_decltors, ";");
+        decl_specs, struct_decltors, t_kind::semicolon);
     def(struct_decls,
         seq(struct_decl));
     def(struct_spec,
-        "struct", opt_id, opt("{", struct_decls, "}"));
+        t_kind::_struct, opt_id,
+        opt(t_kind::lbrace, struct_decls, t_kind::rbrace));
     def(union_spec,
-        "union", opt_id, opt("{", struct_decls, "}"));
+        t_kind::_union, opt_id,
+        opt(t_kind::lbrace, struct_decls, t_kind::rbrace));
 
     def(enumtor,
-        identifier, opt("=", const_exp));
+        identifier, opt(t_kind::assign, const_exp));
 
     def(enumtors,
-        "{", comma_seq(enumtor_put), "}");
+        t_kind::lbrace, comma_seq(enumtor_put), t_kind::rbrace);
     def(enum_spec,
-        "enum", opt_id, opt(enumtors));
+        t_kind::_enum, opt_id, opt(enumtors));
     def_aux(type_spec,
             bar(simple_type_spec, struct_spec, union_spec, enum_spec));
 
     def_aux(initzer,
             bar(assign_exp, initzers));
     def(initzers,
-        "{", comma_seq(initzer), opt(","), "}");
+        t_kind::lbrace, comma_seq(initzer), opt(t_kind::comma), t_kind::rbrace);
     def(init_decltor,
-        decltor, opt("=", initzer));
+        decltor, opt(t_kind::assign, initzer));
 
     def_aux(block_item,
             bar(declaration,
@@ -800,16 +814,16 @@ namespace {
                 break_stmt,
                 return_stmt,
                 exp_stmt));
-    def(program, opt(seq(declaration)), "eof");
+    def(program, opt(seq(declaration)), t_kind::eof);
 }
 
-t_ast parse_exp(std::list<t_lexeme>::const_iterator start) {
+t_ast parse_exp(vec<t_lexeme>::const_iterator start) {
     ctx.init(start);
-    syms_(const_exp, "eof");
+    syms_(const_exp, t_kind::eof);
     return ctx.get_result();
 }
 
-t_ast parse_program(std::list<t_lexeme>::const_iterator start) {
+t_ast parse_program(vec<t_lexeme>::const_iterator start) {
     ctx.init(start);
     syms_(program);
     return ctx.get_result();
@@ -84,12 +84,13 @@ struct t_ast {
 };
 
 struct t_lexeme {
-    str uu;
-    str vv;
+    t_kind uu;
+    str_view vv;
     t_loc loc;
+    t_id id = no_id;
 };
 
-t_ast parse_exp(std::list<t_lexeme>::const_iterator start);
-t_ast parse_program(std::list<t_lexeme>::const_iterator);
+t_ast parse_exp(vec<t_lexeme>::const_iterator start);
+t_ast parse_program(vec<t_lexeme>::const_iterator);
 
-extern const vec<str> simple_type_specifiers;
+extern const vec<t_kind> simple_type_specifiers;
@@ -0,0 +1,314 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <experimental/filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.hpp"
+#include "pch.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+// An entry is the magic string, the file's path, size, mtime and content
+// hash, a hash of the rest of the entry, and its pieces, each as its start
+// offset, its size in bytes and its lexemes.  A lexeme is its kind, its
+// offset in the file, whether it is spelled as in the file, and its size,
+// followed by its spelling if it is not.
+
+namespace {
+    // the version is to be changed whenever lex() changes what it
+    // produces; kinds are stored by number, so the names of all kinds, in
+    // order, are hashed in as well
+    _ make_cache_magic() {
+        str kinds;
+        for (_ k = size_t(0); k <= size_t(last_keyword); k++) {
+            kinds += kind_name(t_kind(k));
+            kinds += ' ';
+        }
+        char res[64];
+        std::snprintf(res, sizeof(res), "cc2 lex 2 %016llx\n",
+                      (unsigned long long)content_hash(kinds));
+        return str(res);
+    }
+
+    const _ cache_magic = make_cache_magic();
+
+    template <class t>
+    void put(str& buf, t x) {
+        char bytes[sizeof(t)];
+        std::memcpy(bytes, &x, sizeof(t));
+        buf.append(bytes, sizeof(t));
+    }
+
+    void put_bytes(str& buf, str_view s) {
+        put(buf, uint32_t(s.size()));
+        buf += s;
+    }
+
+    // empty if there is no such entry
+    str read_entry(const str& path) {
+        str res;
+        _ fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return res;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 and S_ISREG(st.st_mode)) {
+            res.resize(st.st_size);
+            _ n = ::read(fd, res.data(), res.size());
+            res.resize(n < 0 ? 0 : n);
+        }
+        close(fd);
+        return res;
+    }
+
+    // reading past the end leaves it not ok
+    class t_cursor {
+        str_view data;
+        size_t pos = 0;
+    public:
+        bool is_ok = true;
+
+        explicit t_cursor(str_view data_)
+            : data(data_) {
+        }
+        bool at_end() const {
+            return pos == data.size();
+        }
+        str_view bytes(size_t n) {
+            if (not is_ok or n > data.size() - pos) {
+                is_ok = false;
+                return "";
+            }
+            _ res = data.substr(pos, n);
+            pos += n;
+            return res;
+        }
+        template <class t>
+        t get() {
+            t x = t();
+            _ b = bytes(sizeof(t));
+            if (is_ok) {
+                std::memcpy(&x, b.data(), sizeof(t));
+            }
+            return x;
+        }
+        str_view get_bytes() {
+            return bytes(get<uint32_t>());
+        }
+        str_view rest() const {
+            return data.substr(pos);
+        }
+    };
+}
+
+t_lex_cache::t_lex_cache(t_file_manager& file_manager_, const str& dir_)
+    : file_manager(file_manager_)
+    , dir(dir_) {
+    if (dir != "") {
+        _ ec = std::error_code();
+        fs::create_directories(dir, ec);
+    }
+}
+
+str t_lex_cache::entry_path(size_t file_idx) const {
+    char name[32];
+    _ hash = content_hash(file_manager.get_abs_path(file_idx));
+    std::snprintf(name, sizeof(name), "%016llx.lex",
+                  (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+str t_lex_cache::encode(size_t file_idx, const t_pp_seq& ls) const {
+    _ text = file_manager.get_text(file_idx);
+    _ base = file_manager.get_loc(file_idx, 0).offset();
+    str res;
+    for (_& lx : ls) {
+        _ offset = lx.loc.offset() - base;
+        _ is_in_text = (text.compare(offset, lx.val.size(), lx.val) == 0);
+        put(res, uint8_t(lx.kind));
+        put(res, uint32_t(offset));
+        put(res, uint8_t(is_in_text));
+        if (is_in_text) {
+            put(res, uint32_t(lx.val.size()));
+        } else {
+            put_bytes(res, lx.val);
+        }
+    }
+    return res;
+}
+
+bool t_lex_cache::decode(size_t file_idx, str_view data,
+                         t_pp_seq& ls) const {
+    _ text = file_manager.get_text(file_idx);
+    _ base = file_manager.get_loc(file_idx, 0).offset();
+    _ c = t_cursor(data);
+    while (c.is_ok and not c.at_end()) {
+        _ kind = c.get<uint8_t>();
+        _ offset = c.get<uint32_t>();
+        _ is_in_text = c.get<uint8_t>();
+        _ val = str_view();
+        if (is_in_text) {
+            _ size = c.get<uint32_t>();
+            if (offset > text.size() or size > text.size() - offset) {
+                return false;
+            }
+            val = text.substr(offset, size);
+        } else {
+            val = c.get_bytes();
+            // the whitespace of a comment is spelled " "
+            if (val == " ") {
+                val = " ";
+            } else if (c.is_ok) {
+                val = save_str(str(val));
+            }
+        }
+        if (not c.is_ok or kind > uint8_t(last_keyword)
+            or offset > text.size()) {
+            return false;
+        }
+        _ id = (t_kind(kind) == t_kind::identifier ? intern(val) : no_id);
+        ls.push_back({t_kind(kind), val, t_loc(base + offset),
+                      empty_hide_set, id});
+    }
+    return c.is_ok;
+}
+
+// a missing, damaged or out of date entry counts as empty
+void t_lex_cache::load(size_t file_idx, t_entry& entry) const {
+    _ data = read_entry(entry_path(file_idx));
+    _ c = t_cursor(data);
+    _ contents = file_manager.get_file_contents(file_idx);
+    _ mtime = file_manager.get_mtime(file_idx);
+    if (c.bytes(cache_magic.size()) != cache_magic
+        or c.get_bytes() != file_manager.get_abs_path(file_idx)
+        or c.get<uint64_t>() != contents.size()) {
+        return;
+    }
+    _ cached_mtime = c.get<uint64_t>();
+    _ cached_hash = c.get<uint64_t>();
+    if (not c.is_ok
+        or (cached_mtime != mtime and cached_hash != content_hash(contents))) {
+        return;
+    }
+    // a damaged lexeme could still decode, as something else
+    _ body_hash = c.get<uint64_t>();
+    if (not c.is_ok or body_hash != content_hash(c.rest())) {
+        return;
+    }
+    _ pieces = std::map<uint32_t, str>();
+    _ piece_cnt = c.get<uint32_t>();
+    for (_ i = 0u; c.is_ok and i < piece_cnt; i++) {
+        _ start = c.get<uint32_t>();
+        pieces[start] = str(c.get_bytes());
+    }
+    if (not c.is_ok) {
+        return;
+    }
+    entry.pieces = std::move(pieces);
+    // refresh the mtime
+    entry.is_changed = (cached_mtime != mtime);
+}
+
+// written to a temporary file first, so that a compiler running at the
+// same time never reads half an entry
+void t_lex_cache::save(size_t file_idx, const t_entry& entry) const {
+    _ contents = file_manager.get_file_contents(file_idx);
+    str data;
+    data += cache_magic;
+    put_bytes(data, file_manager.get_abs_path(file_idx));
+    put(data, uint64_t(contents.size()));
+    put(data, file_manager.get_mtime(file_idx));
+    put(data, content_hash(contents));
+    str body;
+    put(body, uint32_t(entry.pieces.size()));
+    for (_& [start, piece] : entry.pieces) {
+        put(body, start);
+        put_bytes(body, piece);
+    }
+    put(data, content_hash(body));
+    data += body;
+    _ path = entry_path(file_idx);
+    _ tmp_path = path + "." + std::to_string(getpid()) + ".tmp";
+    _ os = std::ofstream(tmp_path, std::ios::binary);
+    os << data;
+    os.close();
+    if (not os) {
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    std::rename(tmp_path.c_str(), path.c_str());
+}
+
+template <class t_fn>
+t_pp_seq t_lex_cache::piece(size_t file_idx, uint32_t start,
+                            t_fn lex_piece) {
+    std::unique_lock<std::mutex> lock(mutex);
+    _ it = entries.find(file_idx);
+    if (it == entries.end()) {
+        // read without the lock, like the lexing below
+        lock.unlock();
+        _ loaded = t_entry();
+        load(file_idx, loaded);
+        lock.lock();
+        it = entries.emplace(file_idx, std::move(loaded)).first;
+    }
+    _& entry = (*it).second;
+    _ piece_it = entry.pieces.find(start);
+    if (piece_it != entry.pieces.end()) {
+        _ ls = t_pp_seq();
+        if (decode(file_idx, (*piece_it).second, ls)) {
+            return ls;
+        }
+        entry.pieces.erase(piece_it);
+    }
+    lock.unlock();
+    _ ls = lex_piece();
+    _ encoded = encode(file_idx, ls);
+    lock.lock();
+    if (entry.pieces.emplace(start, std::move(encoded)).second) {
+        entry.is_changed = true;
+    }
+    return ls;
+}
+
+t_pp_seq t_lex_cache::lex(size_t file_idx) {
+    if (dir == "") {
+        return ::lex(file_idx, file_manager, true);
+    }
+    return piece(file_idx, 0, [&]() {
+        return ::lex(file_idx, file_manager, true);
+    });
+}
+
+// only files lexed by lex() are cached, so not the main file
+t_pp_seq t_lex_cache::lex_raw_text(const t_pp_lexeme& raw) {
+    _ file_idx = file_manager.get_file_idx(raw.loc);
+    if (dir != "") {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (entries.count(file_idx) != 0) {
+            lock.unlock();
+            _ base = file_manager.get_loc(file_idx, 0).offset();
+            _ start = raw.loc.offset() - base;
+            return piece(file_idx, start, [&]() {
+                return ::lex_raw_text(raw, file_manager);
+            });
+        }
+    }
+    return ::lex_raw_text(raw, file_manager);
+}
+
+void t_lex_cache::save() {
+    if (dir == "") {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (_& [file_idx, entry] : entries) {
+        if (entry.is_changed) {
+            save(file_idx, entry);
+            entry.is_changed = false;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "misc.hpp"
+#include "file.hpp"
+#include "lex.hpp"
+
+// Keeps the lexemes of included files in a directory, so that later runs
+// need not lex them again.  A file is lexed lazily in pieces, the first
+// starting at the beginning of the file and the others at a raw_text
+// lexeme; each piece that has been lexed is kept, under the file's path,
+// size, mtime and content hash.  Pieces stay encoded until they are used.
+// Without a directory it only lexes.
+class t_lex_cache {
+    struct t_entry {
+        // start offset -> encoded lexemes
+        std::map<uint32_t, str> pieces;
+        bool is_changed = false;
+    };
+
+    t_file_manager& file_manager;
+    str dir;
+    std::mutex mutex;
+    std::unordered_map<size_t, t_entry> entries;
+
+    str entry_path(size_t) const;
+    void load(size_t, t_entry&) const;
+    void save(size_t, const t_entry&) const;
+    str encode(size_t, const t_pp_seq&) const;
+    bool decode(size_t, str_view, t_pp_seq&) const;
+    template <class t_fn>
+    t_pp_seq piece(size_t, uint32_t, t_fn);
+public:
+    t_lex_cache(t_file_manager&, const str& dir);
+    t_pp_seq lex(size_t file_idx);
+    t_pp_seq lex_raw_text(const t_pp_lexeme&);
+    void save();
+};
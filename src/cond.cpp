@@ -0,0 +1,364 @@
+#include <cstdint>
+#include <cassert>
+
+#include "cond.hpp"
+
+namespace {
+    // arithmetic is done in the widest integer types, intmax_t and
+    // uintmax_t; bits holds the two's complement representation
+    struct t_value {
+        uintmax_t bits;
+        bool is_unsigned;
+    };
+
+    _ make_signed(intmax_t x) {
+        return t_value{uintmax_t(x), false};
+    }
+
+    _ less(t_value x, t_value y) {
+        if (x.is_unsigned or y.is_unsigned) {
+            return x.bits < y.bits;
+        }
+        return intmax_t(x.bits) < intmax_t(y.bits);
+    }
+
+    class t_cond_parser {
+        t_pp_c_iter it;
+        t_pp_c_iter end;
+        t_loc end_loc;
+        vec<t_compile_error>& warnings;
+        // false inside an operand of &&, || or ?: that is not evaluated
+        bool is_evaluated = true;
+
+        void skip_ws() {
+            while (it != end and ((*it).kind == t_kind::whitespace
+                                  or (*it).kind == t_kind::newline)) {
+                it++;
+            }
+        }
+        t_kind peek() {
+            return it == end ? t_kind::eof : (*it).kind;
+        }
+        t_loc loc() {
+            return it == end ? end_loc : (*it).loc;
+        }
+        void advance() {
+            it++;
+            skip_ws();
+        }
+        bool match(t_kind kind) {
+            if (peek() != kind) {
+                return false;
+            }
+            advance();
+            return true;
+        }
+        void expect(t_kind kind) {
+            if (not match(kind)) {
+                unexpected();
+            }
+        }
+        [[noreturn]] void unexpected() {
+            throw t_compile_error("parse error: unexpected symbol", loc());
+        }
+
+        t_value integer_constant(str_view val) {
+            size_t i = 0;
+            uintmax_t base = 10;
+            if (val.size() >= 2 and val[0] == '0'
+                and (val[1] == 'x' or val[1] == 'X')) {
+                base = 16;
+                i = 2;
+            } else if (val[0] == '0') {
+                base = 8;
+            }
+            _ start = i;
+            uintmax_t w = 0;
+            _ overflow = false;
+            for (; i < val.size(); i++) {
+                _ ch = val[i];
+                uintmax_t d;
+                if ('0' <= ch and ch <= '9') {
+                    d = ch - '0';
+                } else if (base == 16 and 'a' <= ch and ch <= 'f') {
+                    d = ch - 'a' + 10;
+                } else if (base == 16 and 'A' <= ch and ch <= 'F') {
+                    d = ch - 'A' + 10;
+                } else {
+                    break;
+                }
+                if (d >= base) {
+                    throw t_compile_error("bad value", loc());
+                }
+                overflow = overflow or w > (UINTMAX_MAX - d) / base;
+                w = w * base + d;
+            }
+            _ suffix = val.substr(i);
+            _ is_u = [](char ch) {
+                return ch == 'u' or ch == 'U';
+            };
+            _ has_u = false;
+            if (not suffix.empty() and is_u(suffix.front())) {
+                suffix.remove_prefix(1);
+                has_u = true;
+            } else if (not suffix.empty() and is_u(suffix.back())) {
+                suffix.remove_suffix(1);
+                has_u = true;
+            }
+            if (i == start or not (suffix == "" or suffix == "l"
+                                   or suffix == "L" or suffix == "ll"
+                                   or suffix == "LL")) {
+                throw t_compile_error("bad value", loc());
+            }
+            if (overflow) {
+                throw t_compile_error("unrepresentable value", loc());
+            }
+            return t_value{w, has_u or w > uintmax_t(INTMAX_MAX)};
+        }
+
+        // as gcc does: a single char is a signed char, and the chars of a
+        // multi-character constant make up an int, the first one highest
+        t_value char_constant(str_view chars) {
+            if (chars.empty()) {
+                throw t_compile_error("empty character constant", loc());
+            }
+            if (chars.size() > sizeof(int32_t)) {
+                throw t_compile_error("character constant too long", loc());
+            }
+            if (chars.size() == 1) {
+                return make_signed((signed char)chars[0]);
+            }
+            uint32_t w = 0;
+            for (unsigned char ch : chars) {
+                w = (w << 8) | ch;
+            }
+            return make_signed(int32_t(w));
+        }
+
+        t_value primary() {
+            _ kind = peek();
+            if (kind == t_kind::lparen) {
+                advance();
+                _ res = comma_exp();
+                expect(t_kind::rparen);
+                return res;
+            }
+            if (it == end) {
+                unexpected();
+            }
+            _ val = (*it).val;
+            t_value res;
+            if (kind == t_kind::identifier) {
+                res = make_signed(0);
+            } else if (kind == t_kind::pp_number) {
+                if (val.find('.') != str_view::npos
+                    or ((val.find('e') != str_view::npos
+                         or val.find('E') != str_view::npos)
+                        and not (val.size() >= 2
+                                 and (val[1] == 'x' or val[1] == 'X')))) {
+                    throw t_compile_error("floating constant in #if",
+                                          loc());
+                }
+                res = integer_constant(val);
+            } else if (kind == t_kind::char_constant) {
+                res = char_constant(val.substr(1, val.size() - 2));
+            } else {
+                unexpected();
+            }
+            advance();
+            return res;
+        }
+
+        t_value unary() {
+            if (match(t_kind::plus)) {
+                return unary();
+            }
+            if (match(t_kind::minus)) {
+                _ x = unary();
+                return t_value{uintmax_t(0) - x.bits, x.is_unsigned};
+            }
+            if (match(t_kind::tilde)) {
+                _ x = unary();
+                return t_value{~x.bits, x.is_unsigned};
+            }
+            if (match(t_kind::log_not)) {
+                return make_signed(unary().bits == 0);
+            }
+            return primary();
+        }
+
+        static int precedence(t_kind kind) {
+            switch (kind) {
+            case t_kind::star: case t_kind::slash: case t_kind::percent:
+                return 10;
+            case t_kind::plus: case t_kind::minus:
+                return 9;
+            case t_kind::shl: case t_kind::shr:
+                return 8;
+            case t_kind::lt: case t_kind::gt: case t_kind::le: case t_kind::ge:
+                return 7;
+            case t_kind::eq: case t_kind::ne:
+                return 6;
+            case t_kind::amp:
+                return 5;
+            case t_kind::caret:
+                return 4;
+            case t_kind::bit_or:
+                return 3;
+            case t_kind::log_and:
+                return 2;
+            case t_kind::log_or:
+                return 1;
+            default:
+                return 0;
+            }
+        }
+
+        t_value apply(t_kind op, t_value x, t_value y, t_loc op_loc) {
+            _ is_unsigned = x.is_unsigned or y.is_unsigned;
+            _ a = x.bits;
+            _ b = y.bits;
+            _ sa = intmax_t(a);
+            _ sb = intmax_t(b);
+            _ arith = [&](uintmax_t bits) {
+                return t_value{bits, is_unsigned};
+            };
+            switch (op) {
+            case t_kind::star:
+                return arith(a * b);
+            case t_kind::slash:
+            case t_kind::percent:
+                if (b == 0) {
+                    if (not is_evaluated) {
+                        return arith(0);
+                    }
+                    throw t_compile_error("division by zero", op_loc);
+                }
+                if (is_unsigned) {
+                    return arith(op == t_kind::slash ? a / b : a % b);
+                }
+                if (sa == INTMAX_MIN and sb == -1) {
+                    return arith(op == t_kind::slash ? a : 0);
+                }
+                return make_signed(op == t_kind::slash ? sa / sb : sa % sb);
+            case t_kind::plus:
+                return arith(a + b);
+            case t_kind::minus:
+                return arith(a - b);
+            case t_kind::shl:
+            case t_kind::shr: {
+                // the shift count is taken modulo the width, as the hardware
+                // does, and the result has the type of the left operand
+                _ n = b % 64;
+                if (op == t_kind::shl) {
+                    return t_value{a << n, x.is_unsigned};
+                }
+                if (x.is_unsigned) {
+                    return t_value{a >> n, true};
+                }
+                return make_signed(sa >> n);
+            }
+            case t_kind::lt:
+                return make_signed(less(x, y));
+            case t_kind::gt:
+                return make_signed(less(y, x));
+            case t_kind::le:
+                return make_signed(not less(y, x));
+            case t_kind::ge:
+                return make_signed(not less(x, y));
+            case t_kind::eq:
+                return make_signed(a == b);
+            case t_kind::ne:
+                return make_signed(a != b);
+            case t_kind::amp:
+                return arith(a & b);
+            case t_kind::caret:
+                return arith(a ^ b);
+            case t_kind::bit_or:
+                return arith(a | b);
+            default:
+                assert(false);
+                return arith(0);
+            }
+        }
+
+        // operator precedence parsing of the binary operators
+        t_value binary(int min_prec) {
+            _ x = unary();
+            while (true) {
+                _ op = peek();
+                _ prec = precedence(op);
+                if (prec < min_prec or prec == 0) {
+                    return x;
+                }
+                _ op_loc = loc();
+                advance();
+                if (op == t_kind::log_and or op == t_kind::log_or) {
+                    _ x_is_true = (x.bits != 0);
+                    _ short_circuit = (op == t_kind::log_and ? not x_is_true
+                                       : x_is_true);
+                    _ was_evaluated = is_evaluated;
+                    is_evaluated = was_evaluated and not short_circuit;
+                    _ y = binary(prec + 1);
+                    is_evaluated = was_evaluated;
+                    if (short_circuit) {
+                        x = make_signed(x_is_true);
+                    } else {
+                        x = make_signed(y.bits != 0);
+                    }
+                } else {
+                    x = apply(op, x, binary(prec + 1), op_loc);
+                }
+            }
+        }
+
+        t_value exp() {
+            _ cond = binary(1);
+            if (not match(t_kind::question)) {
+                return cond;
+            }
+            _ was_evaluated = is_evaluated;
+            is_evaluated = was_evaluated and cond.bits != 0;
+            _ x = comma_exp();
+            expect(t_kind::colon);
+            is_evaluated = was_evaluated and cond.bits == 0;
+            _ y = exp();
+            is_evaluated = was_evaluated;
+            _ res = (cond.bits != 0 ? x : y);
+            res.is_unsigned = x.is_unsigned or y.is_unsigned;
+            return res;
+        }
+
+        t_value comma_exp() {
+            _ res = exp();
+            while (peek() == t_kind::comma) {
+                warnings.emplace_back("comma operator in #if", loc());
+                advance();
+                res = exp();
+            }
+            return res;
+        }
+    public:
+        t_cond_parser(t_pp_c_iter it_, t_pp_c_iter end_, t_loc end_loc_,
+                      vec<t_compile_error>& warnings_)
+            : it(it_)
+            , end(end_)
+            , end_loc(end_loc_)
+            , warnings(warnings_) {
+            skip_ws();
+        }
+
+        bool eval() {
+            _ res = comma_exp();
+            if (it != end) {
+                unexpected();
+            }
+            return res.bits != 0;
+        }
+    };
+}
+
+bool eval_cond(t_pp_c_iter it, t_pp_c_iter end, t_loc end_loc,
+               vec<t_compile_error>& warnings) {
+    return t_cond_parser(it, end, end_loc, warnings).eval();
+}
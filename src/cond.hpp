@@ -0,0 +1,10 @@
+#pragma once
+
+#include "lex.hpp"
+
+// Evaluates the controlling expression of #if or #elif.  Macros and
+// "defined" must already be replaced; any identifier left counts as 0.
+// What C89 does not allow but other compilers accept, such as the comma
+// operator, is accepted with a warning.
+bool eval_cond(t_pp_c_iter, t_pp_c_iter, t_loc end_loc,
+               vec<t_compile_error>& warnings);
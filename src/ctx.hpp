@@ -6,6 +6,7 @@
 
 #include "prog.hpp"
 #include "val.hpp"
+#include "id.hpp"
 
 class t_undefined_name_error {};
 class t_redefinition_error {};
@@ -14,7 +15,7 @@ template <class t>
 class t_id_namespace {
     const t_id_namespace& _root;
     const t_id_namespace& parent;
-    std::unordered_map<str, t> scope;
+    std::unordered_map<t_id, t> scope;
 public:
     t_id_namespace(const t_id_namespace& _parent)
         : _root(_parent._root)
@@ -30,7 +31,7 @@ public:
     bool is_root() const {
         return &parent == this;
     }
-    const t& scope_get(const str& name) const {
+    const t& scope_get(t_id name) const {
         auto it = scope.find(name);
         if (it != scope.end()) {
             return (*it).second;
@@ -38,10 +39,19 @@ public:
             throw t_undefined_name_error();
         }
     }
-    const std::unordered_map<str, t>& scope_get() const {
+    // a name that was never interned cannot be in any scope, and looking
+    // it up must not add it to the id table
+    const t& scope_get(const str& name) const {
+        _ id = find_id(name);
+        if (id == no_id) {
+            throw t_undefined_name_error();
+        }
+        return scope_get(id);
+    }
+    const std::unordered_map<t_id, t>& scope_get() const {
         return scope;
     }
-    const t& get(const str& name) const {
+    const t& get(t_id name) const {
         try {
             return scope_get(name);
         } catch (t_undefined_name_error) {
@@ -52,8 +62,15 @@ public:
             }
         }
     }
+    const t& get(const str& name) const {
+        _ id = find_id(name);
+        if (id == no_id) {
+            throw t_undefined_name_error();
+        }
+        return get(id);
+    }
     void put(const str& name, const t& data) {
-        scope[name] = data;
+        scope[intern(name)] = data;
     }
 };
 
@@ -1,48 +1,272 @@
 #include <cassert>
+#include <cerrno>
 #include <istream>
 #include <fstream>
+#include <stdexcept>
 #include <experimental/filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "file.hpp"
 
 namespace fs = std::experimental::filesystem;
 
-size_t t_file_manager::read_file(const str& abs_path, const str& rel_path) {
-    _ is = std::ifstream();
-    is.exceptions(std::ifstream::badbit | std::ifstream::failbit);
-    is.open(abs_path);
+namespace {
+    void splice_lines(t_file_data& fd) {
+        _ src = fd.file_contents.view();
+        _ i = src.find("\\\n");
+        if (i == str_view::npos) {
+            return;
+        }
+        _& text = fd.text;
+        text.reserve(src.size());
+        size_t j = 0;
+        while (i != str_view::npos) {
+            text.append(src, j, i - j);
+            fd.splices.push_back(text.size());
+            j = i + 2;
+            i = src.find("\\\n", j);
+        }
+        text.append(src, j, str_view::npos);
+    }
+
+    // is_ok is cleared on a read error, which would otherwise look like
+    // the end of the file
+    _ read_all(int fd, bool& is_ok) {
+        str res;
+        char buf[1 << 16];
+        while (true) {
+            _ n = ::read(fd, buf, sizeof(buf));
+            if (n < 0 and errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                is_ok = false;
+            }
+            if (n <= 0) {
+                break;
+            }
+            res.append(buf, n);
+        }
+        return res;
+    }
+
+    // regular files are mapped, anything else (pipes, terminals) is read
+    _ load_file(int fd, const struct stat& st, bool& is_ok) {
+        if (S_ISREG(st.st_mode) and st.st_size > 0) {
+            _ size = size_t(st.st_size);
+            _ p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                return t_file_buffer(static_cast<const char*>(p), size);
+            }
+        }
+        return t_file_buffer(read_all(fd, is_ok));
+    }
+}
 
-    is.seekg(0, std::ios::end);
-    _ size = is.tellg();
-    _ file_contents = str(size, ' ');
-    is.seekg(0);
-    is.read(file_contents.data(), size);
+t_file_buffer::~t_file_buffer() {
+    if (is_mapped) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+}
+
+// the file is read without holding the lock, so that several files can
+// be loaded at once
+size_t t_file_manager::try_read_file(const str& abs_path,
+                                     const str& rel_path) {
+    std::unique_lock<std::recursive_mutex> lock(mutex);
+    _ path_it = idx_by_path.find(abs_path);
+    if (path_it != idx_by_path.end()) {
+        return (*path_it).second;
+    }
+    lock.unlock();
+    _ fd = open(abs_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return size_t(-1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 or S_ISDIR(st.st_mode)) {
+        close(fd);
+        return size_t(-1);
+    }
+    _ inode = std::make_pair(uint64_t(st.st_dev), uint64_t(st.st_ino));
+    lock.lock();
+    _ inode_it = idx_by_inode.find(inode);
+    if (inode_it != idx_by_inode.end()) {
+        close(fd);
+        idx_by_path[abs_path] = (*inode_it).second;
+        return (*inode_it).second;
+    }
+    lock.unlock();
+    _ mtime = uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    _ is_read = true;
+    _ data = t_file_data{abs_path, rel_path, load_file(fd, st, is_read), 0,
+                         mtime};
+    close(fd);
+    if (not is_read) {
+        throw std::runtime_error("could not read " + abs_path);
+    }
+    splice_lines(data);
+    lock.lock();
+    // another thread may have loaded it in the meantime
+    inode_it = idx_by_inode.find(inode);
+    if (inode_it != idx_by_inode.end()) {
+        idx_by_path[abs_path] = (*inode_it).second;
+        return (*inode_it).second;
+    }
+    // one more offset for the end of the file; checked before the file is
+    // added, so that files and bases stay in step when it throws
+    _ text_size = (data.splices.empty() ? data.file_contents.view().size()
+                                        : data.text.size());
+    _ size = text_size + 1;
+    if (size >= uint32_t(-1) - next_base) {
+        throw std::runtime_error("too much source text");
+    }
+    data.base = next_base;
+    files.push_back(std::move(data));
+    _ idx = files.size() - 1;
+    bases.push_back(next_base);
+    next_base += size;
+    if (S_ISREG(st.st_mode)) {
+        idx_by_path[abs_path] = idx;
+        idx_by_inode[inode] = idx;
+    }
+    return idx;
+}
 
-    files.push_back({abs_path, rel_path, std::move(file_contents)});
-    return files.size() - 1;
+size_t t_file_manager::read_file(const str& abs_path, const str& rel_path) {
+    _ idx = try_read_file(abs_path, rel_path);
+    if (idx == size_t(-1)) {
+        throw std::runtime_error("could not open " + abs_path);
+    }
+    return idx;
 }
 
 size_t t_file_manager::read_file(const str& rel_path) {
-    return read_file(fs::canonical(rel_path), rel_path);
+    // /dev/stdin and the like have no canonical path
+    _ ec = std::error_code();
+    _ abs_path = fs::canonical(rel_path, ec);
+    return read_file(ec ? rel_path : abs_path.string(), rel_path);
+}
+
+// false if dir/rel_path certainly does not exist; the entries of each
+// directory are listed once
+bool t_file_manager::dir_may_contain(const str& dir, const str& rel_path) {
+    _ first = rel_path.substr(0, rel_path.find('/'));
+    if (first == "" or first == "." or first == "..") {
+        return true;
+    }
+    std::unique_lock<std::recursive_mutex> lock(mutex);
+    _ it = dir_entries.find(dir);
+    if (it == dir_entries.end()) {
+        lock.unlock();
+        _ entries = std::unordered_set<str>();
+        _ ec = std::error_code();
+        _ d = fs::directory_iterator(dir, ec);
+        for (; not ec and d != fs::directory_iterator(); d.increment(ec)) {
+            entries.insert((*d).path().filename().string());
+        }
+        lock.lock();
+        it = dir_entries.emplace(dir, std::move(entries)).first;
+    }
+    return (*it).second.count(first) != 0;
+}
+
+size_t t_file_manager::file_count() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return files.size();
+}
+
+str_view t_file_manager::get_file_contents(size_t idx) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    assert(idx < files.size());
+    return files[idx].file_contents.view();
 }
 
-const str& t_file_manager::get_file_contents(size_t idx) const {
+// in nanoseconds
+uint64_t t_file_manager::get_mtime(size_t idx) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     assert(idx < files.size());
-    return files[idx].file_contents;
+    return files[idx].mtime;
+}
+
+str_view t_file_manager::get_text(size_t idx) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    assert(idx < files.size());
+    _& fd = files[idx];
+    return fd.splices.empty() ? fd.file_contents.view() : str_view(fd.text);
 }
 
 const str& t_file_manager::get_path(size_t idx) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     assert(idx < files.size());
     return files[idx].path;
 }
 
 const str& t_file_manager::get_abs_path(size_t idx) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     assert(idx < files.size());
     return files[idx].abs_path;
 }
 
-void t_file_manager::clear() {
-    files.clear();
+t_loc t_file_manager::get_loc(size_t idx, size_t offset) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    assert(idx < files.size());
+    return t_loc(files[idx].base + offset);
+}
+
+size_t t_file_manager::get_file_idx(t_loc loc) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    assert(loc.is_valid());
+    _ it = std::upper_bound(bases.begin(), bases.end(), loc.offset());
+    assert(it != bases.begin());
+    return (it - bases.begin()) - 1;
+}
+
+const vec<size_t>& t_file_manager::get_line_starts(size_t idx) const {
+    _& fd = files[idx];
+    if (fd.line_starts.empty()) {
+        _ src = fd.file_contents.view();
+        fd.line_starts.push_back(0);
+        for (size_t i = 0; i < src.size(); i++) {
+            if (src[i] == '\n') {
+                fd.line_starts.push_back(i + 1);
+            }
+        }
+    }
+    return fd.line_starts;
+}
+
+// the offset in the file as read, before backslash-newlines were removed
+size_t t_file_manager::get_physical_offset(t_loc loc) const {
+    _& fd = files[get_file_idx(loc)];
+    size_t offset = loc.offset() - fd.base;
+    _& sp = fd.splices;
+    _ n = std::upper_bound(sp.begin(), sp.end(), offset) - sp.begin();
+    return offset + 2 * n;
+}
+
+t_full_loc t_file_manager::resolve(t_loc loc) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    _ idx = get_file_idx(loc);
+    _ offset = get_physical_offset(loc);
+    _& ls = get_line_starts(idx);
+    _ line = std::upper_bound(ls.begin(), ls.end(), offset) - ls.begin();
+    return {idx, int(line), int(offset - ls[line - 1])};
+}
+
+str_view t_file_manager::get_line(t_loc loc) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    _ idx = get_file_idx(loc);
+    _ src = get_file_contents(idx);
+    _ offset = std::min(get_physical_offset(loc), src.size());
+    _& ls = get_line_starts(idx);
+    _ line = std::upper_bound(ls.begin(), ls.end(), offset) - ls.begin();
+    _ start = ls[line - 1];
+    _ end = src.find('\n', start);
+    return src.substr(start, end == str_view::npos ? end : end - start);
 }
 
 str get_abs_path(const str& path) {
@@ -1,24 +1,91 @@
 #pragma once
 
 #include <istream>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "misc.hpp"
 
+class t_file_buffer {
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool is_mapped = false;
+    str owned;
+public:
+    t_file_buffer() {
+    }
+    t_file_buffer(const char* data, size_t size)
+        : _data(data)
+        , _size(size)
+        , is_mapped(true) {
+    }
+    t_file_buffer(str s)
+        : owned(std::move(s)) {
+    }
+    t_file_buffer(t_file_buffer&& x)
+        : _data(x._data)
+        , _size(x._size)
+        , is_mapped(x.is_mapped)
+        , owned(std::move(x.owned)) {
+        x.is_mapped = false;
+    }
+    t_file_buffer(const t_file_buffer&) = delete;
+    t_file_buffer& operator=(const t_file_buffer&) = delete;
+    t_file_buffer& operator=(t_file_buffer&&) = delete;
+    ~t_file_buffer();
+    str_view view() const {
+        return is_mapped ? str_view(_data, _size) : str_view(owned);
+    }
+};
+
 struct t_file_data {
     str abs_path;
     str path;
-    str file_contents;
+    t_file_buffer file_contents;
+    uint32_t base = 0;
+    uint64_t mtime = 0;
+    str text = {};
+    vec<size_t> splices = {};
+    mutable vec<size_t> line_starts = {};
+};
+
+struct t_full_loc {
+    size_t file_idx;
+    int line;
+    int column;
 };
 
 class t_file_manager {
-    vec<t_file_data> files;
+    std::deque<t_file_data> files;
+    vec<uint32_t> bases;
+    uint32_t next_base = 0;
+    // a file reached by several paths is loaded once
+    std::unordered_map<str, size_t> idx_by_path;
+    std::map<std::pair<uint64_t, uint64_t>, size_t> idx_by_inode;
+    std::unordered_map<str, std::unordered_set<str>> dir_entries;
+    // files are also loaded by the include prefetch threads
+    mutable std::recursive_mutex mutex;
+
+    const vec<size_t>& get_line_starts(size_t) const;
+    size_t get_physical_offset(t_loc) const;
 public:
+    size_t try_read_file(const str&, const str&);
     size_t read_file(const str&, const str&);
     size_t read_file(const str&);
-    const str& get_file_contents(size_t) const;
+    bool dir_may_contain(const str&, const str&);
+    size_t file_count() const;
+    str_view get_file_contents(size_t) const;
+    uint64_t get_mtime(size_t) const;
+    str_view get_text(size_t) const;
     const str& get_path(size_t) const;
     const str& get_abs_path(size_t) const;
-    void clear();
+    t_loc get_loc(size_t, size_t) const;
+    size_t get_file_idx(t_loc) const;
+    t_full_loc resolve(t_loc) const;
+    str_view get_line(t_loc) const;
 };
 
 str get_file_dir(const str&);
@@ -0,0 +1,131 @@
+#include <unordered_map>
+#include <deque>
+#include <iterator>
+
+#include "hide.hpp"
+
+namespace {
+    using t_ids = vec<t_id>;
+
+    struct t_ids_hash {
+        size_t operator()(const t_ids& x) const {
+            size_t h = x.size();
+            for (_ id : x) {
+                h = h * 31 + id;
+            }
+            return h;
+        }
+    };
+
+    struct t_pair_hash {
+        size_t operator()(const std::pair<uint32_t, uint32_t>& x) const {
+            return (size_t(x.first) << 32) | x.second;
+        }
+    };
+
+    using t_cache = std::unordered_map<std::pair<uint32_t, uint32_t>,
+                                       t_hide_set, t_pair_hash>;
+
+    // the members of every set, sorted, indexed by handle
+    class t_hide_sets {
+        std::deque<t_ids> sets;
+        std::unordered_map<t_ids, t_hide_set, t_ids_hash> handles;
+    public:
+        t_cache insert_cache;
+        t_cache union_cache;
+        t_cache intersection_cache;
+
+        t_hide_sets() {
+            get(t_ids());
+        }
+        t_hide_set get(t_ids ids) {
+            _ it = handles.find(ids);
+            if (it != handles.end()) {
+                return (*it).second;
+            }
+            _ hs = t_hide_set(sets.size());
+            handles.emplace(ids, hs);
+            sets.push_back(std::move(ids));
+            return hs;
+        }
+        const t_ids& operator[](t_hide_set hs) const {
+            return sets[hs];
+        }
+    };
+
+    _& hide_sets() {
+        static t_hide_sets x;
+        return x;
+    }
+
+    template <class t_fn>
+    t_hide_set cached(t_cache& cache, uint32_t x, uint32_t y, t_fn fn) {
+        _ key = std::make_pair(x, y);
+        _ it = cache.find(key);
+        if (it != cache.end()) {
+            return (*it).second;
+        }
+        _ res = fn();
+        cache.emplace(key, res);
+        return res;
+    }
+}
+
+bool hide_set_has(t_hide_set hs, t_id id) {
+    if (hs == empty_hide_set) {
+        return false;
+    }
+    _& ids = hide_sets()[hs];
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+size_t hide_set_size(t_hide_set hs) {
+    return hide_sets()[hs].size();
+}
+
+t_hide_set hide_set_insert(t_hide_set hs, t_id id) {
+    _& sets = hide_sets();
+    return cached(sets.insert_cache, hs, id, [&]() {
+        _ ids = sets[hs];
+        _ it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() and *it == id) {
+            return hs;
+        }
+        ids.insert(it, id);
+        return sets.get(std::move(ids));
+    });
+}
+
+t_hide_set hide_set_union(t_hide_set x, t_hide_set y) {
+    if (x == y or y == empty_hide_set) {
+        return x;
+    }
+    if (x == empty_hide_set) {
+        return y;
+    }
+    _& sets = hide_sets();
+    return cached(sets.union_cache, x, y, [&]() {
+        t_ids ids;
+        std::set_union(sets[x].begin(), sets[x].end(),
+                       sets[y].begin(), sets[y].end(),
+                       std::back_inserter(ids));
+        return sets.get(std::move(ids));
+    });
+}
+
+t_hide_set hide_set_intersection(t_hide_set x, t_hide_set y) {
+    if (x == y) {
+        return x;
+    }
+    if (x == empty_hide_set or y == empty_hide_set) {
+        return empty_hide_set;
+    }
+    _& sets = hide_sets();
+    return cached(sets.intersection_cache, x, y, [&]() {
+        t_ids ids;
+        std::set_intersection(sets[x].begin(), sets[x].end(),
+                              sets[y].begin(), sets[y].end(),
+                              std::back_inserter(ids));
+        return sets.get(std::move(ids));
+    });
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "id.hpp"
+
+// A handle to an interned, immutable set of macro names.  Equal sets get
+// equal handles, so tokens share them and copying one is free.
+using t_hide_set = uint32_t;
+
+constexpr t_hide_set empty_hide_set = 0;
+
+bool hide_set_has(t_hide_set, t_id);
+size_t hide_set_size(t_hide_set);
+t_hide_set hide_set_insert(t_hide_set, t_id);
+t_hide_set hide_set_union(t_hide_set, t_hide_set);
+t_hide_set hide_set_intersection(t_hide_set, t_hide_set);
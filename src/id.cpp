@@ -0,0 +1,75 @@
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "id.hpp"
+
+namespace {
+    // shared by the lexers running on the include prefetch threads
+    class t_id_table {
+        std::deque<str> names;
+        std::unordered_map<str_view, t_id> ids;
+        mutable std::mutex mutex;
+    public:
+        t_id_table() {
+            intern("");
+        }
+        t_id intern(str_view name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            _ it = ids.find(name);
+            if (it != ids.end()) {
+                return (*it).second;
+            }
+            _ id = t_id(names.size());
+            names.push_back(str(name));
+            ids.emplace(names.back(), id);
+            return id;
+        }
+        t_id find(str_view name) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            _ it = ids.find(name);
+            return it == ids.end() ? no_id : (*it).second;
+        }
+        str_view name(t_id id) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return names[id];
+        }
+    };
+
+    _& id_table() {
+        static t_id_table table;
+        return table;
+    }
+
+    _& seen_ids() {
+        thread_local std::unordered_map<str_view, t_id> seen;
+        return seen;
+    }
+}
+
+// each thread remembers the ids it has seen, so the table is only locked
+// for names new to the thread
+t_id intern(str_view name) {
+    _& seen = seen_ids();
+    _ it = seen.find(name);
+    if (it != seen.end()) {
+        return (*it).second;
+    }
+    _ id = id_table().intern(name);
+    seen.emplace(id_table().name(id), id);
+    return id;
+}
+
+// no_id if the name was never interned; unlike intern() it adds nothing
+t_id find_id(str_view name) {
+    _& seen = seen_ids();
+    _ it = seen.find(name);
+    if (it != seen.end()) {
+        return (*it).second;
+    }
+    return id_table().find(name);
+}
+
+str_view id_name(t_id id) {
+    return id_table().name(id);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+#include "misc.hpp"
+
+using t_id = std::uint32_t;
+
+constexpr t_id no_id = 0;
+
+t_id intern(str_view);
+t_id find_id(str_view);
+str_view id_name(t_id);
@@ -0,0 +1,77 @@
+#include <array>
+#include <cassert>
+#include <iterator>
+
+#include "kind.hpp"
+
+namespace {
+    const str_view kind_names[] = {
+        "identifier",
+        "pp_number",
+        "char_constant",
+        "string_literal",
+        "header_name",
+        "newline",
+        "whitespace",
+        "single",
+        "placemarker",
+        "eof",
+        "raw_text",
+        "integer_constant",
+        "floating_constant",
+
+        "...", "<<=", ">>=",
+
+        "&&", "||", "==", "!=", "<=", ">=", "++", "--", "<<", ">>",
+        "=", "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "->", "##",
+
+        "<", ">", "?", ":", "{", "}", "(", ")", ";",
+        "-", "~", "!", "+", "/", "*", "%", "&", "|", "^",
+        "[", "]", ",", ".", "#",
+
+        "auto", "break", "case", "char", "const", "continue", "default", "do",
+        "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
+        "long", "register", "return", "short", "signed", "sizeof", "static",
+        "struct", "switch", "typedef", "union", "unsigned", "void", "volatile",
+        "while",
+    };
+
+    static_assert(std::size(kind_names) == size_t(last_keyword) + 1);
+
+    // a perfect hash of the keywords: no two of them share a slot
+    _ keyword_hash(str_view s) {
+        return (s.length() + s[0] * 54 + s.back()) % 64;
+    }
+
+    _ make_keyword_table() {
+        std::array<t_kind, 64> res;
+        res.fill(t_kind::identifier);
+        for (_ k = size_t(first_keyword); k <= size_t(last_keyword); k++) {
+            _& slot = res[keyword_hash(kind_names[k])];
+            assert(slot == t_kind::identifier);
+            slot = t_kind(k);
+        }
+        return res;
+    }
+
+    const _ keyword_table = make_keyword_table();
+}
+
+str_view kind_name(t_kind kind) {
+    return kind_names[size_t(kind)];
+}
+
+t_kind keyword_kind(str_view id) {
+    if (id.length() < 2 or id.length() > 8) {
+        return t_kind::identifier;
+    }
+    _ kind = keyword_table[keyword_hash(id)];
+    if (kind != t_kind::identifier and kind_name(kind) == id) {
+        return kind;
+    }
+    return t_kind::identifier;
+}
+
+bool is_punctuator(t_kind kind) {
+    return first_punctuator <= kind and kind <= last_punctuator;
+}
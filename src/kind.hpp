@@ -0,0 +1,44 @@
+#pragma once
+
+#include "misc.hpp"
+
+enum class t_kind : unsigned char {
+    identifier,
+    pp_number,
+    char_constant,
+    string_literal,
+    header_name,
+    newline,
+    whitespace,
+    single,
+    placemarker,
+    eof,
+    raw_text,
+    integer_constant,
+    floating_constant,
+
+    ellipsis, shl_assign, shr_assign,
+
+    log_and, log_or, eq, ne, le, ge, inc, dec, shl, shr,
+    assign, mul_assign, div_assign, mod_assign, add_assign, sub_assign,
+    and_assign, xor_assign, or_assign, arrow, hash_hash,
+
+    lt, gt, question, colon, lbrace, rbrace, lparen, rparen, semicolon,
+    minus, tilde, log_not, plus, slash, star, percent, amp, bit_or, caret,
+    lbracket, rbracket, comma, dot, hash,
+
+    _auto, _break, _case, _char, _const, _continue, _default, _do,
+    _double, _else, _enum, _extern, _float, _for, _goto, _if, _int,
+    _long, _register, _return, _short, _signed, _sizeof, _static,
+    _struct, _switch, _typedef, _union, _unsigned, _void, _volatile,
+    _while,
+};
+
+constexpr _ first_punctuator = t_kind::ellipsis;
+constexpr _ last_punctuator = t_kind::hash;
+constexpr _ first_keyword = t_kind::_auto;
+constexpr _ last_keyword = t_kind::_while;
+
+str_view kind_name(t_kind);
+t_kind keyword_kind(str_view);
+bool is_punctuator(t_kind);
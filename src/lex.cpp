@@ -5,21 +5,39 @@
 #include <set>
 #include <list>
 #include <iterator>
-#include <tuple>
 #include <ostream>
+#include <array>
 
 #include "misc.hpp"
 #include "lex.hpp"
+#include "scan.hpp"
 
-const vec<str> punctuators = {
-    "...", "<<=", ">>=",
+namespace {
+    struct t_punctuator {
+        str_view spelling;
+        t_kind kind;
+    };
 
-    "&&", "||", "==", "!=", "<=", ">=", "++", "--", "<<", ">>",
-    "=", "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "->", "##",
+    _ make_punctuator_table() {
+        std::array<vec<t_punctuator>, 256> res;
+        for (_ i = size_t(first_punctuator); i <= size_t(last_punctuator);
+             i++) {
+            _ kind = t_kind(i);
+            _ pu = kind_name(kind);
+            res[pu[0]].push_back({pu, kind});
+        }
+        for (_& bucket : res) {
+            std::stable_sort(bucket.begin(), bucket.end(),
+                             [](const t_punctuator& x, const t_punctuator& y) {
+                                 return (x.spelling.length()
+                                         > y.spelling.length());
+                             });
+        }
+        return res;
+    }
 
-    "<", ">", "=", "?", ":", "{", "}", "(", ")", ";", "-", "~", "!",
-    "+", "/", "*", "%", "&", "|", "^", "[", "]", ",", ".", "#",
-};
+    const _ punctuator_table = make_punctuator_table();
+}
 
 bool is_digit(int c) {
     return '0' <= c and c <= '9';
@@ -33,7 +51,7 @@ bool is_whitespace(char ch) {
     return ch == ' ' or ch == '\t' or ch == '\v' or ch == '\f' or ch == '\n';
 }
 
-void print(const std::list<t_pp_lexeme>& ls, std::ostream& os,
+void print(const t_pp_seq& ls, std::ostream& os,
            const str& separator) {
     _ initial = true;
     for (_& lx : ls) {
@@ -45,122 +63,102 @@ void print(const std::list<t_pp_lexeme>& ls, std::ostream& os,
     }
 }
 
-str pp_kind(const str& val) {
+t_kind pp_kind(str_view val) {
     _ ch = val[0];
     if (is_nondigit(ch)) {
-        return "identifier";
+        return t_kind::identifier;
     }
     if (ch == '"') {
-        return "string_literal";
+        return t_kind::string_literal;
     }
     if (ch == '\'') {
-        return "char_constant";
+        return t_kind::char_constant;
     }
     if (ch == '\n') {
-        return "newline";
+        return t_kind::newline;
     }
     if (is_whitespace(ch)) {
-        return "whitespace";
+        return t_kind::whitespace;
     }
-    _ it = std::find(punctuators.begin(), punctuators.end(), val);
-    if (it != punctuators.end()) {
-        return val;
+    for (_& pu : punctuator_table[ch]) {
+        if (pu.spelling == val) {
+            return pu.kind;
+        }
     }
     if (ch == '.' or is_digit(ch)) {
-        return "pp_number";
+        return t_kind::pp_number;
     }
-    return "single";
+    return t_kind::single;
 }
 
 class t_lexer {
-    const str& src;
+    str_view src;
     size_t idx;
-    t_loc cur_loc;
+    t_loc base_loc;
     t_loc lexeme_loc;
     bool in_include = false;
-    std::list<t_pp_lexeme> result;
+    t_pp_seq result;
+    // when lexing lazily, the text after a line that opens a conditional
+    // group is left as a single raw_text lexeme
+    bool lazily;
+    bool at_group_start = false;
+    size_t line_len = 0;
+    bool line_starts_with_hash = false;
+    str_view directive;
 
     void err(const str& s) {
         throw t_compile_error("lexing error: " + s, lexeme_loc);
     }
 
-    _ set_state(const _& x) {
-        idx = std::get<0>(x);
-        cur_loc = std::get<1>(x);
-    }
-
-    _ get_state() {
-        return std::make_tuple(idx, cur_loc);
-    }
-
     void check_if_in_include() {
         _ n = result.size();
         if (n < 2) {
             return;
         }
         _& l1 = (*next(result.end(), -1)).val;
-        _& l2 = (*next(result.end(), -2)).val;
-        _ nl3 = (n == 2 or (*next(result.end(), -3)).val == "\n");
-        in_include = (nl3 and l2 == "#" and l1 == "include");
+        _ l2 = (*next(result.end(), -2)).kind;
+        _ nl3 = (n == 2 or (*next(result.end(), -3)).kind == t_kind::newline);
+        in_include = (nl3 and l2 == t_kind::hash and l1 == "include");
     }
-    void push(const str& x, const str& val) {
-        result.push_back({x, val, lexeme_loc, {}});
-    }
-    _ advance_real() {
-        idx++;
-        cur_loc.inc(src[idx-1] == '\n');
-    }
-    str advance(int d = 1) {
-        str res;
-        while (d != 0) {
-            while (src.compare(idx, 2, "\\\n") == 0) {
-                advance_real();
-                advance_real();
-            }
-            if (idx >= src.length()) {
-                break;
+    void push(t_kind x, str_view val, t_id id = no_id) {
+        result.push_back({x, val, lexeme_loc, {}, id});
+        if (x == t_kind::newline) {
+            at_group_start = (directive == "if" or directive == "ifdef"
+                              or directive == "ifndef" or directive == "elif"
+                              or directive == "else");
+            line_len = 0;
+            directive = str_view();
+        } else if (x != t_kind::whitespace) {
+            if (line_len == 0) {
+                line_starts_with_hash = (x == t_kind::hash);
+            } else if (line_len == 1 and line_starts_with_hash) {
+                directive = val;
             }
-            res += src[idx];
-            advance_real();
-            d--;
+            line_len++;
         }
-        return res;
+    }
+    str_view since(size_t start) {
+        return str_view(src).substr(start, idx - start);
+    }
+    void advance(size_t d = 1) {
+        idx = std::min(idx + d, src.length());
+    }
+    void advance_to(size_t new_idx) {
+        idx = new_idx;
     }
     bool end() {
         return idx >= src.length();
     }
-    int peek(int n = 0) {
-        _ i = 0;
-        _ j = idx;
-        while (true) {
-            while (src.compare(j, 2, "\\\n") == 0) {
-                j += 2;
-            }
-            if (j >= src.length()) {
-                return -1;
-            }
-            if (i == n) {
-                return src[j];
-            }
-            i++;
-            j++;
+    int peek(size_t n = 0) {
+        if (idx + n >= src.length()) {
+            return -1;
         }
+        return src[idx + n];
     }
-    bool compare(const str& x) {
-        _ old_idx = idx;
-        _ old_loc = cur_loc;
-        _ success = true;
-        for (_ ch : x) {
-            if (end() or peek() != ch) {
-                success = false;
-            }
-            advance();
-        }
-        idx = old_idx;
-        cur_loc = old_loc;
-        return success;
+    bool compare(str_view x) {
+        return src.compare(idx, x.length(), x) == 0;
     }
-    bool match(const str& x) {
+    bool match(str_view x) {
         if (compare(x)) {
             advance(x.length());
             return true;
@@ -169,48 +167,45 @@ class t_lexer {
         }
     }
     bool punctuator() {
-        for (_& pu : punctuators) {
-            if (match(pu)) {
-                push(pu, pu);
+        _ ch = peek();
+        if (ch < 0) {
+            return false;
+        }
+        for (_& pu : punctuator_table[ch]) {
+            _& sp = pu.spelling;
+            size_t i = 1;
+            while (i < sp.length() and peek(i) == sp[i]) {
+                i++;
+            }
+            if (i == sp.length()) {
+                advance(i);
+                push(pu.kind, sp);
                 return true;
             }
         }
         return false;
     }
     bool pp_number() {
-        str val;
+        _ start = idx;
         if (is_digit(peek())) {
-            val += advance();
+            advance();
         } else if (peek() == '.' and is_digit(peek(1))) {
-            val += advance();
-            val += advance();
+            advance(2);
         } else {
             return false;
         }
-        while (true) {
-            if (is_nondigit(peek()) or is_digit(peek()) or peek() == '.') {
-                val += advance();
-            } else if ((peek() == 'e' or peek() == 'E')
-                       and (peek(1) == '+' or peek(1) == '-')) {
-                val += advance();
-                val += advance();
-            } else {
-                break;
-            }
-        }
-        push("pp_number", val);
+        advance_to(skip_pp_number_chars(src, idx));
+        push(t_kind::pp_number, since(start));
         return true;
     }
     bool identifier() {
         if (not is_nondigit(peek())) {
             return false;
         }
-        str val;
-        val += advance();
-        while (is_nondigit(peek()) or is_digit(peek())) {
-            val += advance();
-        }
-        push("identifier", val);
+        _ start = idx;
+        advance_to(skip_identifier_chars(src, idx + 1));
+        _ val = since(start);
+        push(t_kind::identifier, val, intern(val));
         check_if_in_include();
         return true;
     }
@@ -218,79 +213,76 @@ class t_lexer {
         if (peek() != '"') {
             return false;
         }
-        str val;
-        val += advance();
+        _ start = idx;
+        advance();
         while (peek() != '"') {
             if (compare("\\\"") or compare("\\\\")) {
-                val += advance(2);
+                advance(2);
             } else {
                 if (not end() and peek() != '\n') {
-                    val += advance();
+                    advance();
                 } else {
                     err("unbalanced quote");
                 }
             }
         }
-        val += advance();
-        push("string_literal", val);
+        advance();
+        push(t_kind::string_literal, since(start));
         return true;
     }
     bool char_constant() {
         if (peek() != '\'') {
             return false;
         }
-        str val;
-        val += advance();
+        _ start = idx;
+        advance();
         while (peek() != '\'') {
             if (compare("\\\'") or compare("\\\\")) {
-                val += advance(2);
+                advance(2);
             } else {
                 if (not end() and peek() != '\n') {
-                    val += advance();
+                    advance();
                 } else {
                     err("unbalanced quote");
                 }
             }
         }
-        val += advance();
-        if (val.empty()) {
-            err("empty char constant");
-        }
-        push("char_constant", val);
+        advance();
+        push(t_kind::char_constant, since(start));
         return true;
     }
     bool whitespace() {
         if (peek() == '\n') {
-            push("newline", advance());
+            advance();
+            push(t_kind::newline, since(idx - 1));
             in_include = false;
             return true;
         } else if ((is_whitespace(peek()) and peek() != '\n')
                    or compare("/*") or compare("//")) {
-            str val;
+            _ start = idx;
+            _ has_comment = false;
             while (true) {
                 if (match("/*")) {
-                    while (not match("*/")) {
-                        if (end()) {
-                            err("unterminated comment");
-                        }
-                        advance();
+                    _ j = find_comment_end(src, idx);
+                    if (j == str::npos) {
+                        err("unterminated comment");
                     }
-                    val += ' ';
+                    advance_to(j + 2);
+                    has_comment = true;
                 } else if (match("//")) {
-                    while (peek() != '\n') {
-                        if (end()) {
-                            err("unterminated comment");
-                        }
-                        advance();
+                    _ j = src.find('\n', idx);
+                    if (j == str::npos) {
+                        err("unterminated comment");
                     }
-                    val += ' ';
+                    advance_to(j);
+                    has_comment = true;
                 } else if (is_whitespace(peek()) and peek() != '\n') {
-                    val += advance();
+                    advance_to(skip_blanks(src, idx));
                 } else {
                     break;
                 }
             }
-            push("whitespace", val);
+            push(t_kind::whitespace, has_comment ? " " : since(start));
             return true;
         } else {
             return false;
@@ -300,82 +292,86 @@ class t_lexer {
         if (not in_include) {
             return false;
         }
-        _ old_state = get_state();
-        if (peek() == '<') {
-            str val;
-            val += advance();
-            if (peek() == '>') {
-                err("empty header name");
-            }
-            while (peek() != '>') {
-                if (peek() == '\n') {
-                    set_state(old_state);
-                    return false;
-                }
-                val += advance();
-            }
-            val += advance();
-            push("header_name", val);
-            return true;
-        } else if (peek() == '"') {
-            str val;
-            val += advance();
-            if (peek() == '"') {
-                err("empty header name");
-            }
-            while (peek() != '"') {
-                if (peek() == '\n') {
-                    set_state(old_state);
-                    return false;
-                }
-                val += advance();
-            }
-            val += advance();
-            push("header_name", val);
-            return true;
-        } else {
+        _ old_idx = idx;
+        if (peek() != '<' and peek() != '"') {
             return false;
         }
+        _ start = idx;
+        _ close = (peek() == '<' ? '>' : '"');
+        advance();
+        if (peek() == close) {
+            err("empty header name");
+        }
+        while (peek() != close) {
+            if (peek() == '\n') {
+                idx = old_idx;
+                return false;
+            }
+            advance();
+        }
+        advance();
+        push(t_kind::header_name, since(start));
+        return true;
     }
     bool single() {
-        push("single", advance());
+        _ start = idx;
+        advance();
+        push(t_kind::single, since(start));
         return true;
     }
 public:
-    void go() {
-        while (not end()) {
-            lexeme_loc = cur_loc;
+    void go(bool is_whole_file) {
+        while (not end() and not (lazily and at_group_start)) {
+            lexeme_loc = base_loc + idx;
             (whitespace() or header_name() or pp_number() or punctuator()
              or char_constant() or string_literal() or identifier()
              or single());
         }
-        if (not result.empty() and result.back().kind != "newline") {
-            push("newline", "\n");
+        if (not end()) {
+            lexeme_loc = base_loc + idx;
+            push(t_kind::raw_text, src.substr(idx));
+        } else if (not result.empty()
+                   and result.back().kind != t_kind::newline) {
+            push(t_kind::newline, "\n");
+        }
+        if (is_whole_file) {
+            push(t_kind::eof, "");
         }
-        push("eof", "");
-        for (_ it = result.begin(); (*it).kind != "eof";) {
-            if ((*it).val == "L"
-                and ((*next(it)).val[0] == '\''
-                     or ((*next(it)).val[0] == '"'))) {
+        for (_ it = result.begin(); it != result.end();) {
+            _ nx = next(it);
+            if ((*it).val == "L" and nx != result.end()
+                and ((*nx).val[0] == '\'' or (*nx).val[0] == '"')) {
                 it = result.erase(it);
             } else {
                 it++;
             }
         }
     }
-    std::list<t_pp_lexeme> get_result() {
+    t_pp_seq get_result() {
         return std::move(result);
     }
-    t_lexer(size_t file_idx, const t_file_manager& fm)
-        : src(fm.get_file_contents(file_idx))
-        , idx(0)
-        , cur_loc(file_idx, 1, 0)
-        , lexeme_loc(cur_loc) {
+    t_lexer(size_t file_idx, const t_file_manager& fm, size_t start,
+            bool lazily_)
+        : src(fm.get_text(file_idx))
+        , idx(start)
+        , base_loc(fm.get_loc(file_idx, 0))
+        , lexeme_loc(base_loc)
+        , lazily(lazily_) {
     }
 };
 
-std::list<t_pp_lexeme> lex(size_t file_idx, const t_file_manager& fm) {
-    t_lexer lexer(file_idx, fm);
-    lexer.go();
+t_pp_seq lex(size_t file_idx, const t_file_manager& fm, bool lazily) {
+    t_lexer lexer(file_idx, fm, 0, lazily);
+    lexer.go(true);
+    return lexer.get_result();
+}
+
+// lexes the text of a raw_text lexeme up to the start of the next
+// conditional group, leaving the rest as raw text again
+t_pp_seq lex_raw_text(const t_pp_lexeme& raw, const t_file_manager& fm) {
+    _ file_idx = fm.get_file_idx(raw.loc);
+    _ start = raw.loc.offset() - fm.get_loc(file_idx, 0).offset();
+    t_lexer lexer(file_idx, fm, start, true);
+    lexer.go(false);
     return lexer.get_result();
 }
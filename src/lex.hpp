@@ -1,20 +1,29 @@
 #pragma once
 
 #include <list>
-#include <set>
 #include <ostream>
 
 #include "misc.hpp"
 #include "file.hpp"
+#include "kind.hpp"
+#include "id.hpp"
+#include "hide.hpp"
+#include "pool.hpp"
 
 struct t_pp_lexeme {
-    str kind;
-    str val;
+    t_kind kind;
+    str_view val;
     t_loc loc = t_loc();
-    std::set<str> hide_set = {};
+    t_hide_set hide_set = empty_hide_set;
+    t_id id = no_id;
 };
 
-std::list<t_pp_lexeme> lex(size_t, const t_file_manager& fm);
-void print(const std::list<t_pp_lexeme>& ls, std::ostream& os,
+typedef std::list<t_pp_lexeme, t_pool_allocator<t_pp_lexeme>> t_pp_seq;
+typedef t_pp_seq::iterator t_pp_iter;
+typedef t_pp_seq::const_iterator t_pp_c_iter;
+
+t_pp_seq lex(size_t, const t_file_manager& fm, bool lazily = false);
+t_pp_seq lex_raw_text(const t_pp_lexeme&, const t_file_manager&);
+void print(const t_pp_seq& ls, std::ostream& os,
            const str& separator = "");
-str pp_kind(const str&);
+t_kind pp_kind(str_view);
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -35,9 +36,9 @@ void print(const t_ast& ast, std::ostream& os, unsigned level = 0) {
     os.flush();
 }
 
-_ print(const std::list<t_lexeme>& ls, std::ostream& os) {
+_ print(const vec<t_lexeme>& ls, std::ostream& os) {
     for (_& lx : ls) {
-        os << lx.uu;
+        os << kind_name(lx.uu);
         if (not lx.vv.empty()) {
             os << " || \"";
             print_bytes(lx.vv, os);
@@ -48,60 +49,36 @@ _ print(const std::list<t_lexeme>& ls, std::ostream& os) {
     os.flush();
 }
 
-_ get_line_pos(const str& src, int line) {
-    size_t i = 0;
-    _ line_count = 0;
-    if (line_count != line) {
-        while (i < src.size()) {
-            if (i != 0 and src[i-1] == '\n') {
-                line_count++;
-                if (line_count == line) {
-                    break;
-                }
-            }
-            i++;
-        }
-    }
-    return i;
-}
-
 _ die(const str& msg) {
     std::cerr << "error: " << msg << "\n";
     exit(1);
     return 0;
 }
 
-_ concatenate_string_literals(std::list<t_pp_lexeme>& ls) {
-    _ it = ls.begin();
-    while ((*it).kind != "eof") {
-        if ((*it).kind == "string_literal") {
-            while (true) {
-                _ jt = it;
-                jt++;
-                while ((*jt).kind == "whitespace" or (*jt).kind == "newline") {
-                    jt++;
-                }
-                if ((*jt).kind != "string_literal") {
-                    break;
-                }
-                (*it).val.pop_back();
-                (*it).val.append((*jt).val, 1);
-                ls.erase(next(it), next(jt));
-            }
-        }
-        it++;
-    }
-}
-
 namespace {
     _ usage() {
-        cout << "usage: ./build/program [option] <input-file>\n";
+        cout << "usage: ./build/program [options] <input-file>\n";
         cout << "options:\n";
         cout << "--lex        print the preprocessing tokens\n";
         cout << "--pp         print the preprocessed source file\n";
         cout << "--pre-ast    print the tokens after preprocessing\n";
         cout << "--ast        print the abstract syntax tree\n";
         cout << "-o <file>    place the llvm output into <file>\n";
+        cout << "--emit-pch   preprocess a header into a precompiled header,\n";
+        cout << "             <input-file>.pch unless -o is given\n";
+        cout << "--include-pch <file>\n";
+        cout << "             start from a precompiled header, as if the\n";
+        cout << "             header was included before the input file\n";
+        cout << "--lex-cache <dir>\n";
+        cout << "             keep the lexemes of included files in <dir>\n";
+        cout << "             and reuse them in later runs\n";
+        cout << "--pp-stats <file>\n";
+        cout << "             write the time spent on each included file\n";
+        cout << "             and the expansions of each macro to <file>\n";
+        cout << "             as json\n";
+        cout << "-MD          write a make rule for the output file, naming\n";
+        cout << "             the files it was made from, to <output-file>.d\n";
+        cout << "-MF <file>   write the rule to <file> instead\n";
     }
 }
 
@@ -109,11 +86,11 @@ int main(int argc, char** argv) {
     str input_file;
     str output_file;
     str end_phase;
-    if (argc == 2) {
-        input_file = argv[1];
-        output_file = replace_extension(argv[1], ".ll");
-    } else if (argc == 3) {
-        _ option = str(argv[1]);
+    _ pp_options = t_pp_options();
+    _ emit_pch = false;
+    _ writes_deps = false;
+    for (_ i = 1; i < argc; i++) {
+        _ option = str(argv[i]);
         if (option == "--lex") {
             end_phase = "lex";
         } else if (option == "--pp") {
@@ -122,58 +99,77 @@ int main(int argc, char** argv) {
             end_phase = "pre-ast";
         } else if (option == "--ast") {
             end_phase = "ast";
+        } else if (option == "--emit-pch") {
+            emit_pch = true;
+        } else if (option == "--include-pch" and i + 1 < argc) {
+            i++;
+            pp_options.pch_path = argv[i];
+        } else if (option == "--lex-cache" and i + 1 < argc) {
+            i++;
+            pp_options.lex_cache_dir = argv[i];
+        } else if (option == "--pp-stats" and i + 1 < argc) {
+            i++;
+            pp_options.stats_path = argv[i];
+        } else if (option == "-MD") {
+            writes_deps = true;
+        } else if (option == "-MF" and i + 1 < argc) {
+            i++;
+            writes_deps = true;
+            pp_options.deps_path = argv[i];
+        } else if (option == "-o" and i + 1 < argc) {
+            i++;
+            output_file = argv[i];
+        } else if (input_file == "" and option[0] != '-') {
+            input_file = option;
         } else {
             usage();
             return 1;
         }
-        input_file = argv[2];
-    } else if (argc == 4) {
-        if (str(argv[1]) == "-o") {
-            output_file = argv[2];
-            input_file = argv[3];
-        } else {
-            usage();
-            return 1;
-        }
-    } else {
+    }
+    if (input_file == "") {
         usage();
         return 1;
     }
+    if (output_file == "") {
+        output_file = replace_extension(input_file,
+                                        emit_pch ? ".pch" : ".ll");
+    }
+    if (writes_deps) {
+        if (pp_options.deps_path == "") {
+            pp_options.deps_path = replace_extension(output_file, ".d");
+        }
+        pp_options.deps_target = output_file;
+    }
 
     _ fm = t_file_manager();
     size_t input_file_idx;
     try {
         input_file_idx = fm.read_file(input_file);
     } catch (const std::exception& e) {
-        die("could not open " + input_file);
+        die(e.what());
     }
 
     try {
-        _ pp_ls = lex(input_file_idx, fm);
+        _ lex_start = std::chrono::steady_clock::now();
+        _ pp_ls = lex(input_file_idx, fm, end_phase != "lex");
+        pp_options.main_lex_time = std::chrono::steady_clock::now() - lex_start;
         if (end_phase == "lex") {
             print(pp_ls, cout);
             return 0;
         }
 
-        preprocess(pp_ls, fm);
+        if (emit_pch) {
+            make_pch(pp_ls, fm, output_file, pp_options);
+            return 0;
+        }
+        pp_options.squeezes_blank_lines = (end_phase == "pp");
+        preprocess(pp_ls, fm, pp_options);
         if (end_phase == "pp") {
             print(pp_ls, cout);
             return 0;
         }
 
-        escape_seqs(pp_ls.begin(), pp_ls.end());
-        concatenate_string_literals(pp_ls);
-
         _ ls = convert_lexemes(pp_ls.begin(), pp_ls.end());
-
-        for (_ it = ls.begin(); (*it).uu != "eof";) {
-            if ((*it).uu == "const" or (*it).uu == "volatile") {
-                it = ls.erase(it);
-            } else {
-                it++;
-            }
-        }
-
         if (end_phase == "pre-ast") {
             print(ls, cout);
             return 0;
@@ -190,24 +186,22 @@ int main(int argc, char** argv) {
         os.good() or die("could not open output file" + output_file);
         os << res;
     } catch (const t_compile_error& e) {
-        _ src = fm.get_file_contents(e.loc().file_idx());
         _& loc = e.loc();
         _ is_loc_valid = loc.is_valid();
+        _ full_loc = t_full_loc();
         if (is_loc_valid) {
-            std::cerr << fm.get_path(e.loc().file_idx()) << ":";
-            std::cerr << loc.line() << ":" << loc.column() << ": ";
+            full_loc = fm.resolve(loc);
+            std::cerr << fm.get_path(full_loc.file_idx) << ":";
+            std::cerr << full_loc.line << ":" << full_loc.column << ": ";
         }
         std::cerr << "error: ";
         std::cerr << e.what() << "\n";
         if (is_loc_valid) {
-            _ i = get_line_pos(src, loc.line() - 1);
-            for (_ j = i; j < src.size() and src[j] != '\n'; j++) {
-                std::cerr << src[j];
-            }
-            std::cerr << "\n";
-            for (_ j = i; j < i + loc.column(); j++) {
-                if (src[j] == ' ' or src[j] == '\t') {
-                    std::cerr << src[j];
+            _ line = fm.get_line(loc);
+            std::cerr << line << "\n";
+            for (size_t j = 0; j < size_t(full_loc.column); j++) {
+                if (j < line.size() and (line[j] == ' ' or line[j] == '\t')) {
+                    std::cerr << line[j];
                 } else {
                     std::cerr << " ";
                 }
@@ -1,4 +1,6 @@
 #include <cctype>
+#include <deque>
+#include <mutex>
 
 #include "misc.hpp"
 
@@ -10,7 +12,7 @@ _ hex_digit(int x) {
     }
 }
 
-void print_bytes(const str& s, std::ostream& os) {
+void print_bytes(str_view s, std::ostream& os) {
     for (_& ch : s) {
         if (std::isprint(ch) and ch != '"' and ch != '\\') {
             os << ch;
@@ -26,3 +28,11 @@ void constrain(bool constraint, const str& msg, const t_loc& loc) {
         throw t_compile_error(msg, loc);
     }
 }
+
+str_view save_str(str s) {
+    static std::deque<str> saved;
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    saved.push_back(std::move(s));
+    return saved.back();
+}
@@ -3,54 +3,43 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <string_view>
 #include <ostream>
 #include <iostream>
 #include <stdexcept>
+#include <cstdint>
 
 #define _ auto
 
 using str = std::string;
+using str_view = std::string_view;
 using std::cout;
 
 template<class t>
 using vec = std::vector<t>;
 
+// A position in the location space of t_file_manager, where every file
+// read gets its own range of offsets.
 class t_loc {
-    size_t _file_idx;
-    int _line;
-    int _column;
+    uint32_t _offset;
 public:
     bool operator==(const t_loc& x) const {
-        return (_file_idx == x._file_idx
-                and _line == x._line and _column == x._column);
+        return _offset == x._offset;
     }
     bool operator!=(const t_loc& x) const {
         return !(*this == x);
     }
-    t_loc(size_t file_idx_ = -1, int line_ = 1, int column_ = 0)
-        : _file_idx(file_idx_)
-        , _line(line_)
-        , _column(column_) {
+    explicit t_loc(uint32_t offset_ = uint32_t(-1))
+        : _offset(offset_) {
     }
-    int line() const {
-        return _line;
+    t_loc operator+(size_t n) const {
+        return t_loc(_offset + n);
     }
-    int column() const {
-        return _column;
-    }
-    size_t file_idx() const {
-        return _file_idx;
-    }
-    void inc(bool newline) {
-        if (newline) {
-            _line++;
-            _column = 0;
-        } else {
-            _column++;
-        }
+    uint32_t offset() const {
+        return _offset;
     }
     bool is_valid() const {
-        return _file_idx != size_t(-1);
+        return _offset != uint32_t(-1);
     }
 };
 
@@ -71,4 +60,5 @@ auto has(const vec<t>& c, const t& e) {
 }
 
 void constrain(bool, const str&, const t_loc&);
-void print_bytes(const str&, std::ostream&);
+void print_bytes(str_view, std::ostream&);
+str_view save_str(str);
@@ -0,0 +1,118 @@
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+#include "pch.hpp"
+
+namespace {
+    const str_view magic = "cc2 pch 1\n";
+
+    template <class t>
+    void put(str& buf, t x) {
+        char bytes[sizeof(t)];
+        std::memcpy(bytes, &x, sizeof(t));
+        buf.append(bytes, sizeof(t));
+    }
+
+    _ bad_pch() {
+        return t_compile_error("malformed precompiled header");
+    }
+}
+
+void t_pch_writer::u8(uint8_t x) {
+    put(body, x);
+}
+
+void t_pch_writer::u32(uint32_t x) {
+    put(body, x);
+}
+
+void t_pch_writer::u64(uint64_t x) {
+    put(body, x);
+}
+
+void t_pch_writer::string(str_view s) {
+    _ it = string_idx.find(s);
+    if (it == string_idx.end()) {
+        it = string_idx.emplace(s, uint32_t(strings.size())).first;
+        strings.push_back(s);
+    }
+    u32((*it).second);
+}
+
+void t_pch_writer::save(const str& path) const {
+    str head;
+    head += magic;
+    put(head, uint32_t(strings.size()));
+    for (_ s : strings) {
+        put(head, uint32_t(s.size()));
+        head += s;
+    }
+    _ os = std::ofstream(path, std::ios::binary);
+    os << head << body;
+    if (not os) {
+        throw t_compile_error("could not write " + path);
+    }
+}
+
+t_pch_reader::t_pch_reader(const str& path) {
+    _ is = std::ifstream(path, std::ios::binary);
+    if (not is) {
+        throw t_compile_error("could not open " + path);
+    }
+    std::ostringstream contents;
+    contents << is.rdbuf();
+    // the strings are used by the lexemes read from the file
+    data = save_str(contents.str());
+    if (bytes(magic.size()) != magic) {
+        throw bad_pch();
+    }
+    _ n = u32();
+    for (_ i = 0u; i < n; i++) {
+        strings.push_back(bytes(u32()));
+    }
+}
+
+str_view t_pch_reader::bytes(size_t n) {
+    if (n > data.size() - pos) {
+        throw bad_pch();
+    }
+    _ res = data.substr(pos, n);
+    pos += n;
+    return res;
+}
+
+uint8_t t_pch_reader::u8() {
+    uint8_t x;
+    std::memcpy(&x, bytes(sizeof(x)).data(), sizeof(x));
+    return x;
+}
+
+uint32_t t_pch_reader::u32() {
+    uint32_t x;
+    std::memcpy(&x, bytes(sizeof(x)).data(), sizeof(x));
+    return x;
+}
+
+uint64_t t_pch_reader::u64() {
+    uint64_t x;
+    std::memcpy(&x, bytes(sizeof(x)).data(), sizeof(x));
+    return x;
+}
+
+str_view t_pch_reader::string() {
+    _ i = u32();
+    if (i >= strings.size()) {
+        throw bad_pch();
+    }
+    return strings[i];
+}
+
+// 64-bit FNV-1a
+uint64_t content_hash(str_view s) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char ch : s) {
+        h = (h ^ ch) * 1099511628211ull;
+    }
+    return h;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "misc.hpp"
+
+// Binary encoding of precompiled header files.  Strings are stored once in
+// a table at the start of the file and referred to by index.
+class t_pch_writer {
+    str body;
+    vec<str_view> strings;
+    std::unordered_map<str_view, uint32_t> string_idx;
+public:
+    void u8(uint8_t);
+    void u32(uint32_t);
+    void u64(uint64_t);
+    void string(str_view);
+    void save(const str&) const;
+};
+
+class t_pch_reader {
+    str_view data;
+    size_t pos = 0;
+    vec<str_view> strings;
+    str_view bytes(size_t);
+public:
+    explicit t_pch_reader(const str&);
+    uint8_t u8();
+    uint32_t u32();
+    uint64_t u64();
+    str_view string();
+};
+
+uint64_t content_hash(str_view);
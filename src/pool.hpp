@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#include "misc.hpp"
+
+// Blocks of one size carved out of large chunks.  Blocks handed out one
+// after another are adjacent in memory, and a freed block is reused by
+// the next allocation.  Each thread has its own free list and chunk; a
+// block may be freed by another thread than the one that allocated it.
+// Chunks are never given back.
+template <size_t size>
+class t_block_pool {
+    union t_block {
+        t_block* next;
+        alignas(std::max_align_t) unsigned char data[size];
+    };
+
+    static constexpr size_t chunk_size = 1 << 16;
+    static constexpr size_t chunk_blocks =
+        (chunk_size > sizeof(t_block) ? chunk_size / sizeof(t_block) : 1);
+
+    inline static thread_local t_block* free_list = nullptr;
+    inline static thread_local t_block* chunk_pos = nullptr;
+    inline static thread_local t_block* chunk_end = nullptr;
+public:
+    static void* allocate() {
+        if (free_list != nullptr) {
+            _ block = free_list;
+            free_list = (*block).next;
+            return block;
+        }
+        if (chunk_pos == chunk_end) {
+            _ chunk = ::operator new(chunk_blocks * sizeof(t_block));
+            chunk_pos = static_cast<t_block*>(chunk);
+            chunk_end = chunk_pos + chunk_blocks;
+        }
+        return chunk_pos++;
+    }
+    static void deallocate(void* p) {
+        _ block = static_cast<t_block*>(p);
+        (*block).next = free_list;
+        free_list = block;
+    }
+};
+
+// A stateless allocator over t_block_pool.  All instances compare equal,
+// so containers that use it can splice nodes between each other.
+template <class t>
+struct t_pool_allocator {
+    using value_type = t;
+
+    t_pool_allocator() = default;
+    template <class u>
+    t_pool_allocator(const t_pool_allocator<u>&) {
+    }
+    t* allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<t*>(::operator new(n * sizeof(t)));
+        }
+        return static_cast<t*>(t_block_pool<sizeof(t)>::allocate());
+    }
+    void deallocate(t* p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        t_block_pool<sizeof(t)>::deallocate(p);
+    }
+};
+
+template <class t, class u>
+bool operator==(const t_pool_allocator<t>&, const t_pool_allocator<u>&) {
+    return true;
+}
+
+template <class t, class u>
+bool operator!=(const t_pool_allocator<t>&, const t_pool_allocator<u>&) {
+    return false;
+}
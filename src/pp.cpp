@@ -1,61 +1,31 @@
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
+#include <memory>
+#include <tuple>
 #include <cassert>
 #include <ctime>
 #include <fstream>
 
 #include "pp.hpp"
 #include "ast.hpp"
-#include "exp.hpp"
+#include "cond.hpp"
 #include "lex.hpp"
+#include "scan.hpp"
+#include "pch.hpp"
+#include "cache.hpp"
+#include "prefetch.hpp"
+#include "stats.hpp"
 
 namespace {
-    _ unwrap(const str& x) {
+    _ unwrap(str_view x) {
         return x.substr(1, x.length() - 2);
     }
 }
 
-std::list<t_lexeme> convert_lexemes(t_pp_c_iter it, t_pp_c_iter fin) {
-    static const std::unordered_set<str> keywords = {
-        "int", "return", "if", "else", "while", "for", "do",
-        "continue", "break", "struct", "float",
-        "char", "unsigned", "void", "auto", "case", "const",
-        "default", "double", "enum", "extern", "goto", "long",
-        "register", "short", "signed", "sizeof", "static", "struct",
-        "switch", "typedef", "union", "volatile"
-    };
-
-    std::list<t_lexeme> res;
-    for (; it != fin; it++) {
-        _ kind = (*it).kind;
-        _ val = (*it).val;
-        if (kind == "newline" or kind == "whitespace") {
-            continue;
-        }
-        if (kind == "identifier") {
-            if (keywords.count(val) != 0) {
-                kind = val;
-            }
-        } else if (kind == "pp_number") {
-            if (val.find('.') != str::npos or
-                ((val.find('e') != str::npos or val.find('E') != str::npos)
-                 and not (val.length() >= 2
-                          and (val[1] == 'x' or val[1] == 'X')))) {
-                kind = "floating_constant";
-            } else {
-                kind = "integer_constant";
-            }
-        } else if (kind == "char_constant" or kind == "string_literal") {
-            val = unwrap(val);
-        }
-        res.push_back({kind, val, (*it).loc});
-    }
-    return res;
-}
-
 _ print_line(t_pp_iter pos) {
     cout << "`";
-    while ((*pos).kind != "newline") {
+    while ((*pos).kind != t_kind::newline) {
         cout << (*pos).val;
         pos++;
     }
@@ -63,7 +33,7 @@ _ print_line(t_pp_iter pos) {
 }
 
 namespace {
-    _ match(const str& s0, _& idx, const str& s1) {
+    _ match(str_view s0, _& idx, const str& s1) {
         if (s0.compare(idx, s1.length(), s1) == 0) {
             idx += s1.length();
             return true;
@@ -94,71 +64,134 @@ namespace {
         }
         return digit - '0';
     }
-}
 
-void escape_seqs(t_pp_iter it, t_pp_iter fin) {
-    for (; it != fin; it++) {
-        _& val = (*it).val;
-        if ((*it).kind == "char_constant" or (*it).kind == "string_literal") {
-            str new_str;
-            size_t i = 0;
-            while (i < val.length()) {
-                if (match(val, i, "\\")) {
-                    if (i < val.length() and is_octal_digit(val[i])) {
-                        _ ch = octal_digit_to_int(val[i]);
-                        i++;
-                        for (_ j = 1; j < 3; j++) {
-                            if (not (i < val.length()
-                                     and is_octal_digit(val[i]))) {
-                                break;
-                            }
-                            ch = 8 * ch + octal_digit_to_int(val[i]);
-                            i++;
+    // replaces the escape sequences of a character constant or a string
+    // literal
+    str_view unescape(str_view val) {
+        if (val.find('\\') == str_view::npos) {
+            return val;
+        }
+        str new_str;
+        size_t i = 0;
+        while (i < val.length()) {
+            if (match(val, i, "\\")) {
+                if (i < val.length() and is_octal_digit(val[i])) {
+                    _ ch = octal_digit_to_int(val[i]);
+                    i++;
+                    for (_ j = 1; j < 3; j++) {
+                        if (not (i < val.length()
+                                 and is_octal_digit(val[i]))) {
+                            break;
                         }
-                        new_str += char(ch);
-                    } else if (i < val.length() and val[i] == 'x') {
+                        ch = 8 * ch + octal_digit_to_int(val[i]);
                         i++;
-                        _ ch = 0;
-                        while (i < val.length() and is_hex_digit(val[i])) {
-                            ch = 16 * ch + hex_digit_to_int(val[i]);
-                            i++;
-                        }
-                        new_str += char(ch);
-                    } else if (match(val, i, "n")) {
-                        new_str += "\n";
-                    } else if (match(val, i, "a")) {
-                        new_str += "\a";
-                    } else if (match(val, i, "b")) {
-                        new_str += "\b";
-                    } else if (match(val, i, "f")) {
-                        new_str += "\f";
-                    } else if (match(val, i, "r")) {
-                        new_str += "\r";
-                    } else if (match(val, i, "t")) {
-                        new_str += "\t";
-                    } else if (match(val, i, "v")) {
-                        new_str += "\v";
-                    } else if (match(val, i, "\"")) {
-                        new_str += "\"";
-                    } else if (match(val, i, "\\")) {
-                        new_str += "\\";
-                    } else if (match(val, i, "'")) {
-                        new_str += "'";
-                    } else if (match(val, i, "?")) {
-                        new_str += "?";
                     }
-                } else {
-                    new_str += val[i];
+                    new_str += char(ch);
+                } else if (i < val.length() and val[i] == 'x') {
                     i++;
+                    _ ch = 0;
+                    while (i < val.length() and is_hex_digit(val[i])) {
+                        ch = 16 * ch + hex_digit_to_int(val[i]);
+                        i++;
+                    }
+                    new_str += char(ch);
+                } else if (match(val, i, "n")) {
+                    new_str += "\n";
+                } else if (match(val, i, "a")) {
+                    new_str += "\a";
+                } else if (match(val, i, "b")) {
+                    new_str += "\b";
+                } else if (match(val, i, "f")) {
+                    new_str += "\f";
+                } else if (match(val, i, "r")) {
+                    new_str += "\r";
+                } else if (match(val, i, "t")) {
+                    new_str += "\t";
+                } else if (match(val, i, "v")) {
+                    new_str += "\v";
+                } else if (match(val, i, "\"")) {
+                    new_str += "\"";
+                } else if (match(val, i, "\\")) {
+                    new_str += "\\";
+                } else if (match(val, i, "'")) {
+                    new_str += "'";
+                } else if (match(val, i, "?")) {
+                    new_str += "?";
+                }
+            } else {
+                new_str += val[i];
+                i++;
+            }
+        }
+        return save_str(std::move(new_str));
+    }
+
+    void escape_seqs(t_pp_iter it, t_pp_iter fin) {
+        for (; it != fin; it++) {
+            if ((*it).kind == t_kind::char_constant
+                or (*it).kind == t_kind::string_literal) {
+                (*it).val = unescape((*it).val);
+            }
+        }
+    }
+}
+
+// turns the output of the preprocessor into the lexemes of the parser in
+// a single pass: whitespace goes, keywords and the kinds of constants are
+// told apart, escape sequences are replaced, adjacent string literals are
+// joined, and const and volatile, which are not supported, are dropped
+vec<t_lexeme> convert_lexemes(t_pp_c_iter it, t_pp_c_iter fin) {
+    _ skip_blanks = [&](t_pp_c_iter i) {
+        while (i != fin and ((*i).kind == t_kind::newline
+                             or (*i).kind == t_kind::whitespace)) {
+            i++;
+        }
+        return i;
+    };
+    vec<t_lexeme> res;
+    for (; it != fin; it++) {
+        _& lx = *it;
+        _ kind = lx.kind;
+        _ val = lx.val;
+        if (kind == t_kind::newline or kind == t_kind::whitespace) {
+            continue;
+        }
+        if (kind == t_kind::identifier) {
+            kind = keyword_kind(val);
+            if (kind == t_kind::_const or kind == t_kind::_volatile) {
+                continue;
+            }
+        } else if (kind == t_kind::pp_number) {
+            if (val.find('.') != str::npos or
+                ((val.find('e') != str::npos or val.find('E') != str::npos)
+                 and not (val.length() >= 2
+                          and (val[1] == 'x' or val[1] == 'X')))) {
+                kind = t_kind::floating_constant;
+            } else {
+                kind = t_kind::integer_constant;
+            }
+        } else if (kind == t_kind::char_constant) {
+            val = unwrap(unescape(val));
+        } else if (kind == t_kind::string_literal) {
+            val = unwrap(unescape(val));
+            _ nx = skip_blanks(next(it));
+            if (nx != fin and (*nx).kind == t_kind::string_literal) {
+                _ joined = str(val);
+                while (nx != fin and (*nx).kind == t_kind::string_literal) {
+                    joined += unwrap(unescape((*nx).val));
+                    it = nx;
+                    nx = skip_blanks(next(it));
                 }
+                val = save_str(std::move(joined));
             }
-            val = new_str;
         }
+        res.push_back({kind, val, lx.loc, lx.id});
     }
+    return res;
 }
 
 namespace {
-    _ str_lit(const str& x) {
+    _ str_lit(str_view x) {
         str res;
         for (_ ch : x) {
             if (ch == '\\') {
@@ -171,100 +204,223 @@ namespace {
         }
         return res;
     }
+
+    const _ id_defined = intern("defined");
+    const _ id_line = intern("__LINE__");
+    const _ id_file = intern("__FILE__");
+    const _ id_time = intern("__TIME__");
+    const _ id_date = intern("__DATE__");
 }
 
-struct t_macro {
-    t_pp_seq replacement;
-    bool is_func_like = false;
-    std::unordered_map<str, size_t> params = {};
+namespace {
+    // maps locations in the files as they were numbered when a precompiled
+    // header was written to the same files as they are numbered now
+    struct t_loc_map {
+        vec<uint32_t> old_bases;
+        vec<uint32_t> new_bases;
+
+        t_loc operator()(t_loc loc) const {
+            if (not loc.is_valid()) {
+                return loc;
+            }
+            _ it = std::upper_bound(old_bases.begin(), old_bases.end(),
+                                    loc.offset());
+            if (it == old_bases.begin()) {
+                return t_loc();
+            }
+            _ i = size_t(it - old_bases.begin()) - 1;
+            return t_loc(loc.offset() - old_bases[i] + new_bases[i]);
+        }
+    };
+
+    void write_lexeme(t_pch_writer& w, const t_pp_lexeme& lx) {
+        w.u8(uint8_t(lx.kind));
+        w.string(lx.val);
+        w.u32(lx.loc.offset());
+    }
+
+    t_pp_lexeme read_lexeme(t_pch_reader& r, const t_loc_map& loc_map) {
+        _ kind = t_kind(r.u8());
+        _ val = r.string();
+        _ loc = loc_map(t_loc(r.u32()));
+        _ id = (kind == t_kind::identifier ? intern(val) : no_id);
+        return t_pp_lexeme{kind, val, loc, empty_hide_set, id};
+    }
+}
+
+// a replacement list compiled at #define time; each op names a parameter
+// by its index, so expansion never has to look at parameter names
+enum class t_macro_op_kind {
+    token, arg, raw_arg, stringized_arg, paste_token, paste_arg
 };
 
-struct t_macros_find_result {
-    bool success;
-    t_macro macro = t_macro();
+struct t_macro_op {
+    t_macro_op_kind kind;
+    size_t param = 0;
+    t_pp_lexeme lx = t_pp_lexeme{t_kind::placemarker, ""};
+    bool is_last_use = false;
+};
+
+enum class t_builtin_macro {
+    none, line, file, time, date
+};
+
+struct t_macro {
+    vec<t_macro_op> body;
+    bool is_func_like = false;
+    size_t param_cnt = 0;
+    t_builtin_macro builtin = t_builtin_macro::none;
 };
 
 class t_macros {
-    std::unordered_map<str, t_macro> macros;
+    std::unordered_map<t_id, t_macro> macros;
+    // indexed by id; lets expand() reject ordinary identifiers without
+    // hashing them
+    vec<bool> defined;
     t_file_manager& file_manager;
 
+    t_macro& slot(t_id id) {
+        if (id >= defined.size()) {
+            defined.resize(id + 1);
+        }
+        defined[id] = true;
+        return macros[id];
+    }
+
 public:
+    // null unless the expansions are counted
+    t_pp_stats* stats = nullptr;
+
     t_macros(t_file_manager& file_manager_)
         : file_manager(file_manager_) {
-        macros["__STDC__"] = {{t_pp_lexeme{"pp_number", "1"}}};
-        macros["__x86_64__"] = {{}};
-        macros["__STRICT_ANSI__"] = {{}};
+        _ one = t_pp_lexeme{t_kind::pp_number, "1"};
+        slot(intern("__STDC__")) = {{{t_macro_op_kind::token, 0, one}}};
+        slot(intern("__x86_64__")) = {};
+        slot(intern("__STRICT_ANSI__")) = {};
+        slot(id_line).builtin = t_builtin_macro::line;
+        slot(id_file).builtin = t_builtin_macro::file;
+        slot(id_time).builtin = t_builtin_macro::time;
+        slot(id_date).builtin = t_builtin_macro::date;
     }
 
     void erase(const t_pp_lexeme& lx) {
-        macros.erase(lx.val);
+        if (is_defined(lx.id)) {
+            defined[lx.id] = false;
+            macros.erase(lx.id);
+        }
+    }
+
+    void put(t_id id, t_macro macro) {
+        slot(id) = std::move(macro);
     }
 
-    void put(const str& id, bool is_func_like,
-             const std::unordered_map<str, size_t>& params,
-             const t_pp_seq& replace_list) {
-        macros[id] = {replace_list, is_func_like, params};
+    bool is_defined(t_id id) const {
+        return id < defined.size() and defined[id];
     }
 
-    t_macros_find_result find(const t_pp_lexeme& lx) const {
-        _ it = macros.find(lx.val);
-        if (it != macros.end()) {
-            return t_macros_find_result{true, (*it).second};
+    const t_macro* find(const t_pp_lexeme& lx) const {
+        if (not is_defined(lx.id)) {
+            return nullptr;
         }
-        _& id = lx.val;
+        return &macros.at(lx.id);
+    }
+
+    void write(t_pch_writer& w) const {
+        w.u32(macros.size());
+        for (_& [id, macro] : macros) {
+            w.string(id_name(id));
+            w.u8(macro.is_func_like);
+            w.u32(macro.param_cnt);
+            w.u8(uint8_t(macro.builtin));
+            w.u32(macro.body.size());
+            for (_& op : macro.body) {
+                w.u8(uint8_t(op.kind));
+                w.u32(op.param);
+                w.u8(op.is_last_use);
+                write_lexeme(w, op.lx);
+            }
+        }
+    }
+
+    void read(t_pch_reader& r, const t_loc_map& loc_map) {
+        macros.clear();
+        defined.clear();
+        _ n = r.u32();
+        for (_ i = 0u; i < n; i++) {
+            _& macro = slot(intern(r.string()));
+            macro.is_func_like = r.u8();
+            macro.param_cnt = r.u32();
+            macro.builtin = t_builtin_macro(r.u8());
+            _ op_cnt = r.u32();
+            for (_ j = 0u; j < op_cnt; j++) {
+                _ op = t_macro_op{t_macro_op_kind(r.u8())};
+                op.param = r.u32();
+                op.is_last_use = r.u8();
+                op.lx = read_lexeme(r, loc_map);
+                macro.body.push_back(op);
+            }
+        }
+    }
+
+    t_pp_lexeme builtin_value(const t_macro& macro,
+                              const t_pp_lexeme& lx) const {
         str val;
-        if (id == "__LINE__") {
-            val = std::to_string(lx.loc.line());
-        } else if (id == "__FILE__") {
-            _ path = file_manager.get_path(lx.loc.file_idx());
+        _ builtin = macro.builtin;
+        if (builtin == t_builtin_macro::line) {
+            val = std::to_string(file_manager.resolve(lx.loc).line);
+        } else if (builtin == t_builtin_macro::file) {
+            _ path = file_manager.get_path(file_manager.get_file_idx(lx.loc));
             val = "\"" + str_lit(path) + "\"";
-        } else if (id == "__TIME__") {
+        } else if (builtin == t_builtin_macro::time) {
             _ raw_time = std::time(0);
             _ ti = std::localtime(&raw_time);
             char buf[64];
             strftime(buf, sizeof(buf), "%T", ti);
             val = "\"" + str(buf) + "\"";
-        } else if (id == "__DATE__") {
+        } else {
             _ raw_time = std::time(0);
             _ ti = std::localtime(&raw_time);
             char buf[64];
             strftime(buf, sizeof(buf), "%b %e %Y", ti);
             val = "\"" + str(buf) + "\"";
-        } else {
-            return t_macros_find_result{false};
         }
-        _ res_lx = t_pp_lexeme{pp_kind(val), val, lx.loc};
-        return t_macros_find_result{true, {{res_lx}}};
+        _ saved_val = save_str(val);
+        return t_pp_lexeme{pp_kind(saved_val), saved_val, lx.loc};
     }
 };
 
 namespace {
     _ step(_& it) {
         it++;
-        if ((*it).kind == "whitespace") {
+        if ((*it).kind == t_kind::whitespace) {
             it++;
         }
     }
 
-    _ expect(const str& kind, t_pp_iter it) {
+    _ expect(t_kind kind, t_pp_iter it) {
         constrain((*it).kind == kind,
-                  "expected " + kind + ", got " + (*it).kind,
+                  ("expected " + str(kind_name(kind)) + ", got "
+                   + str(kind_name((*it).kind))),
                   (*it).loc);
     }
 
     _ is_eof(_ i) {
-        return (*i).kind == "eof";
+        return (*i).kind == t_kind::eof;
+    }
+
+    _ is_raw_text(_ i) {
+        return (*i).kind == t_kind::raw_text;
     }
 
     _ skip_ws(_ i, _ fin) {
-        if (i != fin and (*i).kind == "whitespace") {
+        if (i != fin and (*i).kind == t_kind::whitespace) {
             i++;
         }
         return i;
     }
 
     _ find_newline(_ it) {
-        while ((*it).kind != "newline") {
+        while ((*it).kind != t_kind::newline) {
             it++;
         }
         return it;
@@ -272,10 +428,10 @@ namespace {
 
     _ pp_hash(_& it) {
         _ jt = it;
-        if ((*jt).kind == "whitespace") {
+        if ((*jt).kind == t_kind::whitespace) {
             jt++;
         }
-        if ((*jt).val != "#") {
+        if ((*jt).kind != t_kind::hash) {
             return false;
         }
         step(jt);
@@ -283,30 +439,83 @@ namespace {
         return true;
     }
 
+    _ skip_blank_tokens(_ it) {
+        while ((*it).kind == t_kind::whitespace
+               or (*it).kind == t_kind::newline) {
+            it++;
+        }
+        return it;
+    }
+
+    // if the whole file is a single #ifndef X ... #endif section, it has no
+    // effect while X is defined, and X is returned
+    t_id find_include_guard(const t_pp_seq& ls) {
+        _ it = skip_blank_tokens(ls.begin());
+        if (not pp_hash(it) or (*it).val != "ifndef") {
+            return no_id;
+        }
+        step(it);
+        if ((*it).kind != t_kind::identifier) {
+            return no_id;
+        }
+        _ guard = (*it).id;
+        _ level = 0;
+        it = next(find_newline(it));
+        while (not is_eof(it)) {
+            if ((*it).kind == t_kind::raw_text) {
+                _ text = (*it).val;
+                str_view cmd;
+                _ i = skip_group(text, 0, level, cmd);
+                if (cmd != "endif") {
+                    return no_id;
+                }
+                i = skip_blank_lines(text, skip_line(text, i));
+                return i == text.size() ? guard : no_id;
+            }
+            _ jt = it;
+            if (pp_hash(jt)) {
+                _ cmd = (*jt).val;
+                if (cmd == "if" or cmd == "ifdef" or cmd == "ifndef") {
+                    level++;
+                } else if (cmd == "endif") {
+                    if (level == 0) {
+                        it = skip_blank_tokens(next(find_newline(jt)));
+                        return is_eof(it) ? guard : no_id;
+                    }
+                    level--;
+                } else if ((cmd == "elif" or cmd == "else") and level == 0) {
+                    return no_id;
+                }
+            }
+            it = next(find_newline(it));
+        }
+        return no_id;
+    }
+
     t_pp_iter expand_defined(t_pp_seq& ls, t_pp_iter i, t_pp_iter fin,
                              const _& macros) {
         _ new_i = i;
         _ initial = true;
         while (i != fin) {
-            if ((*i).val == "defined") {
+            if ((*i).id == id_defined) {
                 _ loc = (*i).loc;
                 _ j = i;
                 step(i);
-                _ in_parens = ((*i).val == "(");
+                _ in_parens = ((*i).kind == t_kind::lparen);
                 if (in_parens) {
                     step(i);
                 }
-                expect("identifier", i);
+                expect(t_kind::identifier, i);
                 _ id = *i;
 
                 if (in_parens) {
                     step(i);
                 }
                 i++;
-                _ macro_find_res = macros.find(id);
-                _ is_defined_str = str(macro_find_res.success ? "1" : "0");
+                _ is_defined = macros.is_defined(id.id);
+                _ is_defined_str = str_view(is_defined ? "1" : "0");
                 j = ls.erase(j, i);
-                _ k = ls.insert(i, {"pp_number", is_defined_str, loc, {}});
+                _ k = ls.insert(i, {t_kind::pp_number, is_defined_str, loc});
                 if (initial) {
                     new_i = k;
                 }
@@ -327,44 +536,45 @@ namespace {
             constrain(j != finish, "unmatched (", loc);
             _& lx = (*j).kind;
             if (paren_cnt == 0) {
-                if (lx == "," or lx == ")") {
+                if (lx == t_kind::comma or lx == t_kind::rparen) {
                     if (arg.empty()) {
-                        _ pm = t_pp_lexeme{"placemarker", "", (*j).loc};
+                        _ pm = t_pp_lexeme{t_kind::placemarker, "", (*j).loc};
                         arg.push_back(pm);
                     } else if (arg.size() == 1
-                               and arg.front().kind == "whitespace") {
-                        _ pm = t_pp_lexeme{"placemarker", "", arg.front().loc};
+                               and arg.front().kind == t_kind::whitespace) {
+                        _ pm = t_pp_lexeme{t_kind::placemarker, "",
+                                           arg.front().loc};
                         arg.clear();
                         arg.push_back(pm);
                     }
                     res.push_back(arg);
                     arg.clear();
                 }
-                if (lx == ")") {
+                if (lx == t_kind::rparen) {
                     break;
                 }
             }
-            if (lx == "(") {
+            if (lx == t_kind::lparen) {
                 paren_cnt++;
             }
-            if (lx == ")") {
+            if (lx == t_kind::rparen) {
                 paren_cnt--;
             }
-            if (not (lx == "," and paren_cnt == 0)) {
+            if (not (lx == t_kind::comma and paren_cnt == 0)) {
                 _ prv_ws = false;
                 if (not arg.empty()) {
-                    if (arg.back().kind == "whitespace") {
-                        if (lx == "newline" or lx == "whitespace") {
+                    if (arg.back().kind == t_kind::whitespace) {
+                        if (lx == t_kind::newline or lx == t_kind::whitespace) {
                             prv_ws = true;
                         }
                     }
                 }
                 if (not prv_ws) {
                     arg.push_back(*j);
-                    if (arg.back().val == "\n") {
-                        arg.back().kind = "whitespace";
+                    if (arg.back().kind == t_kind::newline) {
+                        arg.back().kind = t_kind::whitespace;
                     }
-                    if (arg.back().kind == "whitespace") {
+                    if (arg.back().kind == t_kind::whitespace) {
                         arg.back().val = " ";
                     }
                 }
@@ -378,43 +588,40 @@ namespace {
                      const t_macros& macros);
 
     _ glue(t_pp_seq& ls, t_pp_seq rs) {
-        if (ls.back().kind == "whitespace") {
+        if (ls.back().kind == t_kind::whitespace) {
             ls.pop_back();
         }
-        if (rs.front().kind == "whitespace") {
+        if (rs.front().kind == t_kind::whitespace) {
             rs.pop_front();
         }
         _& x = ls.back();
         _& y = rs.front();
-        std::set<str> hs;
-        std::set_intersection(x.hide_set.begin(), x.hide_set.end(),
-                              y.hide_set.begin(), y.hide_set.end(),
-                              std::inserter(hs, hs.begin()));
-        x.hide_set = hs;
-        x.val += y.val;
+        x.hide_set = hide_set_intersection(x.hide_set, y.hide_set);
+        x.val = save_str(str(x.val) + str(y.val));
         if (x.val == "") {
-            x.kind = "placemarker";
+            x.kind = t_kind::placemarker;
         } else {
             x.kind = pp_kind(x.val);
         }
+        x.id = (x.kind == t_kind::identifier ? intern(x.val) : no_id);
         rs.pop_front();
         ls.splice(ls.end(), rs);
     }
 
     _ stringize(t_pp_seq ls) {
-        if (not ls.empty() and ls.back().kind == "whitespace") {
+        if (not ls.empty() and ls.back().kind == t_kind::whitespace) {
             ls.pop_back();
         }
-        if (not ls.empty() and ls.front().kind == "whitespace") {
+        if (not ls.empty() and ls.front().kind == t_kind::whitespace) {
             ls.pop_front();
         }
         assert(not ls.empty());
         str val;
         val += "\"";
-        if (ls.front().kind != "placemarker") {
+        if (ls.front().kind != t_kind::placemarker) {
             for (_& lx : ls) {
-                if (lx.kind == "char_constant"
-                    or lx.kind == "string_literal") {
+                if (lx.kind == t_kind::char_constant
+                    or lx.kind == t_kind::string_literal) {
                     val += str_lit(lx.val);
                 } else {
                     val += lx.val;
@@ -422,172 +629,195 @@ namespace {
             }
         }
         val += "\"";
-        return t_pp_lexeme{"string_literal", val, ls.front().loc, {}};
+        return t_pp_lexeme{t_kind::string_literal, save_str(val),
+                           ls.front().loc, {}};
     }
 
-    void substitute(_ i, _ finish, const std::unordered_map<str, size_t>& fp,
-                    const vec<t_pp_seq>& ap, const _& hs, _& os,
-                    const _& macros) {
-        if (i == finish) {
-            for (_& x : os) {
-                x.hide_set.insert(hs.begin(), hs.end());
+    t_macro compile_macro(bool is_func_like,
+                          const std::unordered_map<t_id, size_t>& params,
+                          const t_pp_seq& replace_list) {
+        _ res = t_macro{{}, is_func_like, params.size()};
+        _& body = res.body;
+        _ finish = replace_list.end();
+        _ param = [&](t_pp_c_iter it, size_t& idx) {
+            if (it == finish) {
+                return false;
             }
-            return;
-        }
-        if ((*i).val == "#") {
-            _ i1 = skip_ws(next(i), finish);
-            if (i1 != finish) {
-                _ p_it = fp.find((*i1).val);
-                if (p_it != fp.end()) {
-                    _ idx = (*p_it).second;
-                    os.push_back(stringize(ap[idx]));
-                    i1++;
-                    substitute(i1, finish, fp, ap, hs, os, macros);
-                    return;
-                }
+            _ p_it = params.find((*it).id);
+            if (p_it == params.end()) {
+                return false;
             }
-        }
-        if ((*i).val == "##") {
+            idx = (*p_it).second;
+            return true;
+        };
+        for (_ i = replace_list.begin(); i != finish;) {
             _ i1 = skip_ws(next(i), finish);
-            if (i1 != finish) {
-                _ p_it = fp.find((*i1).val);
-                constrain(not os.empty(),
+            size_t idx;
+            if ((*i).kind == t_kind::hash and param(i1, idx)) {
+                body.push_back({t_macro_op_kind::stringized_arg, idx});
+                i = next(i1);
+            } else if ((*i).kind == t_kind::hash_hash) {
+                constrain(not body.empty() and i1 != finish,
                           "## cannot occur at the beginning or at the end of "
                           "a replacement list", (*i).loc);
-                if (p_it != fp.end()) {
-                    _ idx = (*p_it).second;
-                    glue(os, ap[idx]);
+                if (param(i1, idx)) {
+                    body.push_back({t_macro_op_kind::paste_arg, idx});
+                } else {
+                    body.push_back({t_macro_op_kind::paste_token, 0, *i1});
+                }
+                i = next(i1);
+            } else if (param(i, idx)) {
+                if (i1 != finish and (*i1).kind == t_kind::hash_hash) {
+                    body.push_back({t_macro_op_kind::raw_arg, idx});
+                    i = i1;
                 } else {
-                    glue(os, {*i1});
+                    body.push_back({t_macro_op_kind::arg, idx});
+                    i++;
                 }
-                i1++;
-                substitute(i1, finish, fp, ap, hs, os, macros);
-                return;
+            } else {
+                body.push_back({t_macro_op_kind::token, 0, *i});
+                i++;
+            }
+        }
+        _ is_used = vec<bool>(params.size());
+        for (_ it = body.rbegin(); it != body.rend(); it++) {
+            if ((*it).kind == t_macro_op_kind::arg
+                and not is_used[(*it).param]) {
+                (*it).is_last_use = true;
+                is_used[(*it).param] = true;
             }
         }
+        return res;
+    }
 
-        _ p_it = fp.find((*i).val);
-        if (p_it != fp.end()) {
-            _ idx = (*p_it).second;
-            _ arg = ap[idx];
-            _ i1 = skip_ws(next(i), finish);
-            if (i1 != finish and (*i1).val == "##") {
-                os.splice(os.end(), arg);
-                substitute(i1, finish, fp, ap, hs, os, macros);
+    void substitute(const t_macro& macro, const vec<t_pp_seq>& ap,
+                    t_hide_set hs, t_pp_seq& os, const t_macros& macros) {
+        // each argument is expanded on its first use only
+        _ expanded = vec<t_pp_seq>(ap.size());
+        _ is_expanded = vec<bool>(ap.size());
+        for (_& op : macro.body) {
+            _ kind = op.kind;
+            if (kind == t_macro_op_kind::token) {
+                os.push_back(op.lx);
+            } else if (kind == t_macro_op_kind::arg) {
+                _& arg = expanded[op.param];
+                if (not is_expanded[op.param]) {
+                    arg = ap[op.param];
+                    if (macros.stats != nullptr) {
+                        macros.stats->enter_arg();
+                    }
+                    expand(arg, arg.begin(), arg.end(), macros);
+                    if (macros.stats != nullptr) {
+                        macros.stats->leave_arg();
+                    }
+                    is_expanded[op.param] = true;
+                }
+                if (op.is_last_use) {
+                    os.splice(os.end(), arg);
+                } else {
+                    os.insert(os.end(), arg.begin(), arg.end());
+                }
+            } else if (kind == t_macro_op_kind::raw_arg) {
+                os.insert(os.end(), ap[op.param].begin(), ap[op.param].end());
+            } else if (kind == t_macro_op_kind::stringized_arg) {
+                os.push_back(stringize(ap[op.param]));
+            } else if (kind == t_macro_op_kind::paste_token) {
+                glue(os, {op.lx});
             } else {
-                expand(arg, arg.begin(), arg.end(), macros);
-                os.splice(os.end(), arg);
-                i++;
-                substitute(i, finish, fp, ap, hs, os, macros);
+                glue(os, ap[op.param]);
             }
-            return;
         }
-        os.push_back(*i);
-        i++;
-        substitute(i, finish, fp, ap, hs, os, macros);
+        for (_& x : os) {
+            x.hide_set = hide_set_union(x.hide_set, hs);
+        }
     }
 
+    // rescans [i, finish) until no macro is left, replacing each macro
+    // invocation in place and continuing from the start of its
+    // replacement; returns the new beginning of the range
     t_pp_iter expand(t_pp_seq& ls, t_pp_iter i, t_pp_iter finish,
                      const t_macros& macros) {
-        _ macro = t_macro();
         _ i0 = i;
         _ initial = true;
-        while (true) {
-            if (i == finish) {
-                return i0;
-            }
-            if ((*i).kind == "identifier"
-                and (*i).hide_set.count((*i).val) == 0) {
-                _ macro_find_res = macros.find(*i);
-                if (macro_find_res.success) {
-                    macro = macro_find_res.macro;
-                    break;
-                }
-            }
-            i++;
-            initial = false;
-        }
-        _& hs = (*i).hide_set;
-        if (macro.is_func_like) {
-            _ j = i;
-            j++;
-            while (j != finish and ((*j).kind == "whitespace"
-                                    or (*j).kind == "newline")) {
-                j++;
+        while (i != finish) {
+            const t_macro* macro = nullptr;
+            if ((*i).kind == t_kind::identifier
+                and macros.is_defined((*i).id)
+                and not hide_set_has((*i).hide_set, (*i).id)) {
+                macro = macros.find(*i);
             }
-            if (j == finish or (*j).kind != "(") {
-                expand(ls, next(i), finish, macros);
-                return i0;
+            if (macro == nullptr) {
+                i++;
+                initial = false;
+                continue;
             }
-            j++;
-            _ args = collect_args(j, finish);
-            if (macro.params.size() == 0 and args.size() == 1
-                and args.front().front().kind == "placemarker") {
-                args.clear();
-            }
-            constrain(macro.params.size() == args.size(),
-                      "wrong number of arguments", (*i).loc);
-            _& rparen_hs = (*j).hide_set;
-            j++;
-            std::set<str> nhs;
-            std::set_intersection(hs.begin(), hs.end(),
-                                  rparen_hs.begin(), rparen_hs.end(),
-                                  std::inserter(nhs, nhs.begin()));
-            nhs.insert((*i).val);
+            _ hs = (*i).hide_set;
+            _ j = next(i);
             t_pp_seq r;
-            _& mr = macro.replacement;
-            substitute(mr.begin(), mr.end(), macro.params, args, nhs, r,
-                       macros);
-            for (_ m = r.begin(); m != r.end();) {
-                if ((*m).kind == "placemarker") {
-                    m = r.erase(m);
+            _ nhs = hs;
+            if ((*macro).is_func_like) {
+                while (j != finish and ((*j).kind == t_kind::whitespace
+                                        or (*j).kind == t_kind::newline)) {
+                    j++;
+                }
+                if (j == finish or (*j).kind != t_kind::lparen) {
+                    i++;
+                    initial = false;
+                    continue;
+                }
+                j++;
+                _ args = collect_args(j, finish);
+                if ((*macro).param_cnt == 0 and args.size() == 1
+                    and args.front().front().kind == t_kind::placemarker) {
+                    args.clear();
+                }
+                constrain((*macro).param_cnt == args.size(),
+                          "wrong number of arguments", (*i).loc);
+                nhs = hide_set_intersection(hs, (*j).hide_set);
+                nhs = hide_set_insert(nhs, (*i).id);
+                j++;
+                substitute(*macro, args, nhs, r, macros);
+                for (_ m = r.begin(); m != r.end();) {
+                    if ((*m).kind == t_kind::placemarker) {
+                        m = r.erase(m);
+                    } else {
+                        m++;
+                    }
+                }
+            } else {
+                nhs = hide_set_insert(hs, (*i).id);
+                if ((*macro).builtin != t_builtin_macro::none) {
+                    r.push_back(macros.builtin_value(*macro, *i));
+                    r.back().hide_set = nhs;
                 } else {
-                    m++;
+                    substitute(*macro, {}, nhs, r, macros);
                 }
             }
+            if (macros.stats != nullptr) {
+                macros.stats->count_expansion((*i).id, r, nhs);
+            }
             i = ls.erase(i, j);
-            i = ls.insert(i, r.begin(), r.end());
-            expand(ls, i, finish, macros);
-            if (initial) {
-                i0 = i;
+            if (not r.empty()) {
+                _ first = r.begin();
+                ls.splice(i, r);
+                i = first;
             }
-            return i0;
-        } else {
-            _ nhs = hs;
-            nhs.insert((*i).val);
-            t_pp_seq r;
-            _& mr = macro.replacement;
-            substitute(mr.begin(), mr.end(), {}, {}, nhs, r, macros);
-            i = ls.erase(i);
-            i = ls.insert(i, r.begin(), r.end());
-            expand(ls, i, finish, macros);
             if (initial) {
                 i0 = i;
             }
-            return i0;
         }
+        return i0;
     }
 
     _ eval_condition(t_pp_seq& ls, t_pp_iter& pos, t_pp_iter line_end,
-                     const _& macros) {
+                     const _& macros, vec<t_compile_error>& warnings) {
         if (pos == line_end) {
             return true;
         }
         pos = expand_defined(ls, pos, line_end, macros);
         pos = expand(ls, pos, line_end, macros);
         escape_seqs(pos, line_end);
-        for (_ it = pos; it != line_end; it++) {
-            if ((*it).kind == "identifier") {
-                (*it).kind = "pp_number";
-                (*it).val = "0";
-            }
-        }
-        _ exp_ls = convert_lexemes(pos, line_end);
-        exp_ls.push_back({"eof", "", (*line_end).loc});
-        _ exp_ast = parse_exp(exp_ls.begin());
-        t_ctx exp_ctx;
-        _ val = gen_exp(exp_ast, exp_ctx);
-        return val.u_val() != 0;
+        return eval_cond(pos, line_end, (*line_end).loc, warnings);
     }
 }
 
@@ -596,19 +826,45 @@ class t_preprocessor {
     t_pp_iter pos;
     t_macros macros;
     t_file_manager& file_manager;
+    vec<str> system_dirs;
+    // (including file's directory, spelling, is quoted) -> file index
+    std::map<std::tuple<str, str, bool>, size_t> include_paths;
+    std::unordered_map<size_t, t_id> include_guards;
+    std::unordered_set<size_t> once_only_files;
+    // the output of the precompiled header, put before the output of the
+    // main file
+    t_pp_seq pch_lexemes;
+    t_pp_options options;
+    t_lex_cache lex_cache;
+    t_prefetcher prefetcher;
+    std::unique_ptr<t_pp_stats> stats;
+    // the files the output is made from, in the order they were first
+    // used: the main file, the files of a precompiled header and every
+    // file named by an #include.  not every file the file manager has
+    // loaded, as the prefetcher reads files that may never be included
+    vec<size_t> used_files;
+    std::unordered_set<size_t> is_used;
+    // the precompiled header included, if any
+    str used_pch_path;
+
+    void use_file(size_t file_idx) {
+        if (is_used.insert(file_idx).second) {
+            used_files.push_back(file_idx);
+        }
+    }
 
     void skip(bool ws = true) {
         pos = lex_seq.erase(pos);
-        if (ws and (*pos).kind == "whitespace") {
+        if (ws and (*pos).kind == t_kind::whitespace) {
             pos = lex_seq.erase(pos);
         }
     }
     void skip_newline() {
-        expect("newline", pos);
+        expect(t_kind::newline, pos);
         pos = lex_seq.erase(pos);
     }
     void skip_until_next_line() {
-        while ((*pos).kind != "newline") {
+        while ((*pos).kind != t_kind::newline) {
             skip();
         }
         pos = lex_seq.erase(pos);
@@ -619,7 +875,7 @@ class t_preprocessor {
         if (not pp_hash(it)) {
             return false;
         }
-        if (not ((*it).kind == "identifier" and (*it).val == name)) {
+        if (not ((*it).kind == t_kind::identifier and (*it).val == name)) {
             return false;
         }
         step(it);
@@ -629,10 +885,10 @@ class t_preprocessor {
 
     _ simple_lines() {
         _ it = pos;
-        if (is_eof(it) or pp_hash(it)) {
+        if (is_eof(it) or is_raw_text(it) or pp_hash(it)) {
             return false;
         }
-        while (not is_eof(it)) {
+        while (not is_eof(it) and not is_raw_text(it)) {
             _ jt = it;
             if (pp_hash(jt)) {
                 break;
@@ -645,51 +901,78 @@ class t_preprocessor {
         return true;
     }
 
+    // replaces the raw_text lexeme at pos with the lexemes of its text up
+    // to the next conditional group
+    void lex_raw_text_at_pos(const t_pp_lexeme& raw) {
+        if (stats != nullptr) {
+            stats->start_lex();
+        }
+        _ ls = lex_cache.lex_raw_text(raw);
+        if (stats != nullptr) {
+            stats->end_lex(file_manager.get_file_idx(raw.loc), ls);
+        }
+        pos = lex_seq.erase(pos);
+        if (not ls.empty()) {
+            _ first = ls.begin();
+            lex_seq.splice(pos, ls);
+            pos = first;
+        }
+    }
+
+    _ raw_text() {
+        if (not is_raw_text(pos)) {
+            return false;
+        }
+        lex_raw_text_at_pos(*pos);
+        return true;
+    }
+
     _ define() {
         if (not command("define")) {
             return false;
         }
-        expect("identifier", pos);
-        _ id = (*pos).val;
-        constrain(id != "defined",
+        expect(t_kind::identifier, pos);
+        _ id = (*pos).id;
+        constrain(id != id_defined,
                   "'defined' cannot be used as a a macro name", (*pos).loc);
         skip(false);
         _ is_func_like = false;
-        std::unordered_map<str, size_t> params;
-        if ((*pos).kind == "(") {
+        std::unordered_map<t_id, size_t> params;
+        if ((*pos).kind == t_kind::lparen) {
             is_func_like = true;
             skip();
             size_t i = 0;
-            while ((*pos).kind != "newline" and (*pos).kind != ")") {
+            while ((*pos).kind != t_kind::newline
+                   and (*pos).kind != t_kind::rparen) {
                 if (not params.empty()) {
-                    expect(",", pos);
+                    expect(t_kind::comma, pos);
                     skip();
                 }
-                expect("identifier", pos);
-                params[(*pos).val] = i;
+                expect(t_kind::identifier, pos);
+                params[(*pos).id] = i;
                 skip();
                 i++;
             }
-            if ((*pos).kind == "newline") {
-                expect(")", pos);
+            if ((*pos).kind == t_kind::newline) {
+                expect(t_kind::rparen, pos);
             }
             skip();
         } else {
-            if ((*pos).kind == "whitespace") {
+            if ((*pos).kind == t_kind::whitespace) {
                 skip(false);
             }
         }
         t_pp_seq replace_list;
-        while ((*pos).kind != "newline") {
+        while ((*pos).kind != t_kind::newline) {
             replace_list.push_back(*pos);
             skip(false);
         }
         skip(false);
         if (not replace_list.empty()
-            and replace_list.back().kind == "whitespace") {
+            and replace_list.back().kind == t_kind::whitespace) {
             replace_list.pop_back();
         }
-        macros.put(id, is_func_like, params, replace_list);
+        macros.put(id, compile_macro(is_func_like, params, replace_list));
         return true;
     }
 
@@ -697,23 +980,20 @@ class t_preprocessor {
         if (not command("undef")) {
             return false;
         }
-        expect("identifier", pos);
+        expect(t_kind::identifier, pos);
         macros.erase(*pos);
         skip();
         skip_newline();
         return true;
     }
 
-    _ include_search(const vec<str>& dirs, const str& rel_path) {
-        for (_& dir : dirs) {
-            _ abs_path = dir + "/" + rel_path;
-            // cout << "search " << abs_path << "\n";
-            try {
-                return file_manager.read_file(abs_path, rel_path);
-            } catch (const std::ifstream::failure&) {
-            }
+    _ can_skip(size_t file_idx) {
+        if (once_only_files.count(file_idx) != 0) {
+            return true;
         }
-        return size_t(-1);
+        _ it = include_guards.find(file_idx);
+        return (it != include_guards.end() and (*it).second != no_id
+                and macros.is_defined((*it).second));
     }
 
     _ include() {
@@ -722,9 +1002,9 @@ class t_preprocessor {
         }
         _ arg_loc = (*pos).loc;
         _ end = find_newline(pos);
-        constrain((*pos).kind != "newline",
+        constrain((*pos).kind != t_kind::newline,
                   "expected <filename> or \"filename\"", arg_loc);
-        if ((*next(end, -1)).kind == "whitespace") {
+        if ((*next(end, -1)).kind == t_kind::whitespace) {
             end--;
         }
         pos = expand(lex_seq, pos, end, macros);
@@ -735,28 +1015,57 @@ class t_preprocessor {
         constrain(((val[0] == '<' and val.back() == '>')
                    or (val[0] == '"' and val.back() == '"')),
                   "expected <filename> or \"filename\"", arg_loc);
-        const _ rel_path = unwrap(val);
-        _ file_idx = size_t(-1);
-        if (val[0] == '"') {
-            _ cur_path = file_manager.get_abs_path(arg_loc.file_idx());
-            file_idx = include_search({get_file_dir(cur_path)}, rel_path);
+        const _ rel_path = str(unwrap(val));
+        _ is_quoted = (val[0] == '"');
+        _ cur_dir = str();
+        if (is_quoted) {
+            _ cur_idx = file_manager.get_file_idx(arg_loc);
+            cur_dir = get_file_dir(file_manager.get_abs_path(cur_idx));
         }
-        if (file_idx == size_t(-1)) {
-            _ dirs = vec<str>{
-                "/usr/local/include",
-                get_abs_path(".") + "/include",
-                "/usr/include/x86_64-linux-gnu",
-                "/include",
-                "/usr/include",
-            };
-            file_idx = include_search(dirs, rel_path);
-            constrain(file_idx != size_t(-1),
-                      "could not open " + rel_path, arg_loc);
-            // cout << "incl " << file_manager.get_abs_path(file_idx) << "\n";
+        if (stats != nullptr) {
+            stats->start_lex();
+        }
+        _ key = std::make_tuple(cur_dir, rel_path, is_quoted);
+        _ cached = include_paths.find(key);
+        _ file_idx = size_t(-1);
+        if (cached != include_paths.end()) {
+            file_idx = (*cached).second;
+        } else {
+            if (is_quoted) {
+                file_idx = search_include(file_manager, {cur_dir}, rel_path);
+            }
+            if (file_idx == size_t(-1)) {
+                file_idx = search_include(file_manager, system_dirs,
+                                          rel_path);
+                constrain(file_idx != size_t(-1),
+                          "could not open " + rel_path, arg_loc);
+                // cout << "incl " << file_manager.get_abs_path(file_idx)
+                //      << "\n";
+            }
+            include_paths[key] = file_idx;
         }
+        use_file(file_idx);
         skip_until_next_line();
-        _ pp_ls = lex(file_idx, file_manager);
-        assert(not pp_ls.empty() and pp_ls.back().kind == "eof");
+        if (stats != nullptr) {
+            stats->count_include(file_idx);
+        }
+        if (can_skip(file_idx)) {
+            if (stats != nullptr) {
+                stats->end_lex(file_idx, {});
+            }
+            return true;
+        }
+        _ pp_ls = t_pp_seq();
+        if (not prefetcher.take(file_idx, pp_ls)) {
+            pp_ls = lex_cache.lex(file_idx);
+        }
+        if (stats != nullptr) {
+            stats->end_lex(file_idx, pp_ls);
+        }
+        assert(not pp_ls.empty() and pp_ls.back().kind == t_kind::eof);
+        if (include_guards.count(file_idx) == 0) {
+            include_guards[file_idx] = find_include_guard(pp_ls);
+        }
         pp_ls.pop_back();
         if (not pp_ls.empty()) {
             _ inc_start = pp_ls.begin();
@@ -771,7 +1080,7 @@ class t_preprocessor {
         if (not pp_hash(it)) {
             return false;
         }
-        if ((*it).val != "\n") {
+        if ((*it).kind != t_kind::newline) {
             return false;
         }
         pos = lex_seq.erase(pos, it);
@@ -783,6 +1092,9 @@ class t_preprocessor {
         if (not command("pragma")) {
             return false;
         }
+        if ((*pos).kind == t_kind::identifier and (*pos).val == "once") {
+            once_only_files.insert(file_manager.get_file_idx((*pos).loc));
+        }
         skip_until_next_line();
         return true;
     }
@@ -793,7 +1105,7 @@ class t_preprocessor {
         }
         _ loc = (*pos).loc;
         str msg;
-        while ((*pos).kind != "newline") {
+        while ((*pos).kind != t_kind::newline) {
             if (msg != "") {
                 msg += " ";
             }
@@ -810,7 +1122,7 @@ class t_preprocessor {
         } else {
             _ block_begin = pos;
             _ level = 0;
-            while (not is_eof(pos)) {
+            while (not is_eof(pos) and not is_raw_text(pos)) {
                 _ i = pos;
                 if (pp_hash(i)) {
                     _ cmd_ = (*i).val;
@@ -828,13 +1140,38 @@ class t_preprocessor {
                 pos = find_newline(pos);
                 pos++;
             }
-            lex_seq.erase(block_begin, pos);
+            pos = lex_seq.erase(block_begin, pos);
+            if (is_raw_text(pos)) {
+                // not lexed yet, so the group is skipped as plain text
+                _ raw = *pos;
+                str_view cmd;
+                _ i = skip_group(raw.val, 0, level, cmd);
+                if (i == raw.val.size()) {
+                    pos = lex_seq.erase(pos);
+                } else {
+                    raw.val.remove_prefix(i);
+                    raw.loc = raw.loc + i;
+                    lex_raw_text_at_pos(raw);
+                }
+            }
         }
     }
 
+    void warn(const t_compile_error& w) {
+        _ full_loc = file_manager.resolve(w.loc());
+        std::cerr << file_manager.get_path(full_loc.file_idx) << ":"
+                  << full_loc.line << ":" << full_loc.column
+                  << ": warning: " << w.what() << "\n";
+    }
+
     _ if_aux(bool& found_true, t_pp_iter line_end) {
+        _ warnings = vec<t_compile_error>();
         _ cond_is_true = (not found_true
-                          and eval_condition(lex_seq, pos, line_end, macros));
+                          and eval_condition(lex_seq, pos, line_end, macros,
+                                             warnings));
+        for (_& w : warnings) {
+            warn(w);
+        }
         pos = lex_seq.erase(pos, line_end);
         skip(false);
         if_block(cond_is_true);
@@ -846,10 +1183,12 @@ class t_preprocessor {
     _ if_group(bool& found_true) {
         if (command("if")) {
         } else if (command("ifdef")) {
-            pos = lex_seq.insert(pos, {"identifier", "defined"});
+            pos = lex_seq.insert(pos, {t_kind::identifier, "defined", t_loc(),
+                                       {}, id_defined});
         } else if (command("ifndef")) {
-            pos = lex_seq.insert(pos, {"identifier", "defined"});
-            pos = lex_seq.insert(pos, {"!", "!"});
+            pos = lex_seq.insert(pos, {t_kind::identifier, "defined", t_loc(),
+                                       {}, id_defined});
+            pos = lex_seq.insert(pos, {t_kind::log_not, "!"});
         } else {
             return false;
         }
@@ -902,7 +1241,10 @@ class t_preprocessor {
     }
 
     _ group_part() {
-        return if_section() or control_line() or simple_lines();
+        if (stats != nullptr) {
+            stats->step((*pos).loc);
+        }
+        return if_section() or control_line() or raw_text() or simple_lines();
     }
 
     void group() {
@@ -910,17 +1252,60 @@ class t_preprocessor {
         }
     }
 
+    // a make rule, with an empty rule for each header so that make does
+    // not fail once a header is deleted
+    void write_deps() {
+        _ quote = [](str_view path) {
+            str res;
+            for (_ ch : path) {
+                if (ch == ' ' or ch == '#') {
+                    res += '\\';
+                } else if (ch == '$') {
+                    res += '$';
+                }
+                res += ch;
+            }
+            return res;
+        };
+        _ os = std::ofstream(options.deps_path);
+        if (not os) {
+            throw std::runtime_error("could not open " + options.deps_path);
+        }
+        _ deps = vec<str>();
+        for (_ file_idx : used_files) {
+            if (deps.empty()) {
+                deps.push_back(file_manager.get_path(file_idx));
+                if (used_pch_path != "") {
+                    deps.push_back(used_pch_path);
+                }
+            } else {
+                deps.push_back(file_manager.get_abs_path(file_idx));
+            }
+        }
+        os << quote(options.deps_target) << ":";
+        for (_& dep : deps) {
+            os << " \\\n  " << quote(dep);
+        }
+        os << "\n";
+        for (_ i = 1u; i < deps.size(); i++) {
+            os << "\n" << quote(deps[i]) << ":\n";
+        }
+        if (not os) {
+            throw std::runtime_error("could not write " + options.deps_path);
+        }
+    }
+
     void kill_consecutive_blank_lines() {
         _ it = lex_seq.begin();
         _ last_line_empty = false;
-        while ((*it).kind != "eof") {
-            if (last_line_empty and (*it).kind == "newline") {
+        while ((*it).kind != t_kind::eof) {
+            if (last_line_empty and (*it).kind == t_kind::newline) {
                 it = lex_seq.erase(it);
             } else {
-                if ((*it).kind == "newline") {
+                if ((*it).kind == t_kind::newline) {
                     last_line_empty = true;
                 } else {
-                    while ((*it).kind != "newline") {
+                    while ((*it).kind != t_kind::newline) {
                         it++;
                     }
                     last_line_empty = false;
@@ -930,21 +1315,190 @@ class t_preprocessor {
         }
     }
 public:
-    t_preprocessor(t_pp_seq& ls, t_file_manager& file_manager_)
+    t_preprocessor(t_pp_seq& ls, t_file_manager& file_manager_,
+                   const t_pp_options& options_)
         : lex_seq(ls)
         , pos(ls.begin())
         , macros(file_manager_)
-        , file_manager(file_manager_) {
+        , file_manager(file_manager_)
+        , system_dirs({
+                "/usr/local/include",
+                get_abs_path(".") + "/include",
+                "/usr/include/x86_64-linux-gnu",
+                "/include",
+                "/usr/include",
+            })
+        , options(options_)
+        , lex_cache(file_manager_, options.lex_cache_dir)
+        , prefetcher(file_manager_, lex_cache, system_dirs) {
+        if (options.stats_path != "") {
+            stats = std::make_unique<t_pp_stats>(file_manager);
+            macros.stats = stats.get();
+            for (_& lx : lex_seq) {
+                if (lx.loc.is_valid()) {
+                    stats->add_lex(file_manager.get_file_idx(lx.loc),
+                                   lex_seq, options.main_lex_time);
+                    break;
+                }
+            }
+        }
+        if (not lex_seq.empty() and lex_seq.front().loc.is_valid()) {
+            _ file_idx = file_manager.get_file_idx(lex_seq.front().loc);
+            prefetcher.scan(file_idx);
+            use_file(file_idx);
+        }
     }
 
     void scan() {
         group();
-        expect("eof", pos);
-        kill_consecutive_blank_lines();
+        expect(t_kind::eof, pos);
+        prefetcher.stop();
+        lex_cache.save();
+        if (stats != nullptr) {
+            stats->write(options.stats_path);
+        }
+        if (options.deps_path != "") {
+            write_deps();
+        }
+        if (options.squeezes_blank_lines) {
+            kill_consecutive_blank_lines();
+        }
+        lex_seq.splice(lex_seq.begin(), pch_lexemes);
+    }
+
+    // the files the header was made from are recorded with their mtime and
+    // a hash of their contents; a file whose mtime has changed is still
+    // up to date if its contents have not.  locations are rebased onto the
+    // files as loaded when the header is used, so the files are written
+    // in the order of their locations, the header first.  files are
+    // referred to by their position in this list
+    void write_pch(const str& path) {
+        t_pch_writer w;
+        _ files = used_files;
+        std::sort(files.begin(), files.end());
+        _ file_pos = std::unordered_map<size_t, uint32_t>();
+        w.u32(files.size());
+        for (_ k = 0u; k < files.size(); k++) {
+            _ i = files[k];
+            file_pos[i] = k;
+            w.string(file_manager.get_abs_path(i));
+            w.string(file_manager.get_path(i));
+            w.u32(file_manager.get_loc(i, 0).offset());
+            w.u64(file_manager.get_mtime(i));
+            w.u64(content_hash(file_manager.get_file_contents(i)));
+        }
+        _ lexeme_cnt = uint32_t(0);
+        for (_ it = lex_seq.begin(); not is_eof(it); it++) {
+            lexeme_cnt++;
+        }
+        w.u32(lexeme_cnt);
+        for (_ it = lex_seq.begin(); not is_eof(it); it++) {
+            write_lexeme(w, *it);
+        }
+        macros.write(w);
+        w.u32(include_guards.size());
+        for (_& [file_idx, guard] : include_guards) {
+            w.u32(file_pos.at(file_idx));
+            w.string(id_name(guard));
+        }
+        w.u32(once_only_files.size());
+        for (_ file_idx : once_only_files) {
+            w.u32(file_pos.at(file_idx));
+        }
+        w.save(path);
+    }
+
+    // if any of the files has changed, the header is included as text
+    void include_pch(const str& path) {
+        t_pch_reader r(path);
+        used_pch_path = path;
+        _ file_cnt = r.u32();
+        _ loc_map = t_loc_map();
+        _ file_idxs = vec<size_t>();
+        _ is_valid = true;
+        str header_abs_path;
+        str header_path;
+        for (_ i = 0u; i < file_cnt; i++) {
+            _ abs_path = str(r.string());
+            _ rel_path = str(r.string());
+            _ base = r.u32();
+            _ mtime = r.u64();
+            _ hash = r.u64();
+            if (i == 0) {
+                header_abs_path = abs_path;
+                header_path = rel_path;
+            }
+            if (not is_valid) {
+                continue;
+            }
+            _ idx = file_manager.try_read_file(abs_path, rel_path);
+            if (idx == size_t(-1)
+                or (file_manager.get_mtime(idx) != mtime
+                    and (content_hash(file_manager.get_file_contents(idx))
+                         != hash))) {
+                is_valid = false;
+                continue;
+            }
+            loc_map.old_bases.push_back(base);
+            loc_map.new_bases.push_back(file_manager.get_loc(idx, 0).offset());
+            file_idxs.push_back(idx);
+        }
+        if (not is_valid) {
+            std::cerr << "warning: " << path << " is out of date, including "
+                      << header_path << " instead\n";
+            _ idx = file_manager.read_file(header_abs_path, header_path);
+            use_file(idx);
+            _ ls = lex(idx, file_manager, true);
+            ls.pop_back();
+            if (not ls.empty()) {
+                _ first = ls.begin();
+                lex_seq.splice(pos, ls);
+                pos = first;
+            }
+            return;
+        }
+        for (_ idx : file_idxs) {
+            use_file(idx);
+        }
+        _ file_idx = [&]() {
+            _ i = r.u32();
+            constrain(i < file_idxs.size(), "malformed precompiled header",
+                      t_loc());
+            return file_idxs[i];
+        };
+        _ lexeme_cnt = r.u32();
+        for (_ i = 0u; i < lexeme_cnt; i++) {
+            pch_lexemes.push_back(read_lexeme(r, loc_map));
+        }
+        macros.read(r, loc_map);
+        _ guard_cnt = r.u32();
+        for (_ i = 0u; i < guard_cnt; i++) {
+            _ idx = file_idx();
+            include_guards[idx] = intern(r.string());
+        }
+        _ once_cnt = r.u32();
+        for (_ i = 0u; i < once_cnt; i++) {
+            once_only_files.insert(file_idx());
+        }
     }
 };
 
-void preprocess(t_pp_seq& ls, t_file_manager& fm) {
-    _ pp = t_preprocessor(ls, fm);
+void preprocess(t_pp_seq& ls, t_file_manager& fm,
+                const t_pp_options& options) {
+    _ pp = t_preprocessor(ls, fm, options);
+    if (options.pch_path != "") {
+        pp.include_pch(options.pch_path);
+    }
+    pp.scan();
+}
+
+// the header keeps its lines squeezed, as it is printed along with the
+// output of the file that uses it
+void make_pch(t_pp_seq& ls, t_file_manager& fm, const str& pch_path,
+              const t_pp_options& options) {
+    _ pch_options = options;
+    pch_options.squeezes_blank_lines = true;
+    _ pp = t_preprocessor(ls, fm, pch_options);
     pp.scan();
+    pp.write_pch(pch_path);
 }
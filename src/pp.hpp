@@ -1,15 +1,28 @@
 #pragma once
 
+#include <chrono>
 #include <list>
 
 #include "lex.hpp"
 #include "ast.hpp"
 #include "file.hpp"
 
-typedef std::list<t_pp_lexeme> t_pp_seq;
-typedef std::list<t_pp_lexeme>::iterator t_pp_iter;
-typedef std::list<t_pp_lexeme>::const_iterator t_pp_c_iter;
+struct t_pp_options {
+    // a precompiled header to start from
+    str pch_path;
+    str lex_cache_dir;
+    // where to write the --pp-stats report, if anywhere
+    str stats_path;
+    // the main file is lexed before preprocessing starts
+    std::chrono::steady_clock::duration main_lex_time = {};
+    // where to write a make rule for deps_target, if anywhere
+    str deps_path;
+    str deps_target;
+    // only the printed output needs them
+    bool squeezes_blank_lines = false;
+};
 
-void preprocess(t_pp_seq&, t_file_manager&);
-std::list<t_lexeme> convert_lexemes(t_pp_c_iter it, t_pp_c_iter fin);
-void escape_seqs(t_pp_iter it, t_pp_iter fin);
+void preprocess(t_pp_seq&, t_file_manager&, const t_pp_options& = {});
+void make_pch(t_pp_seq&, t_file_manager&, const str& pch_path,
+              const t_pp_options& = {});
+vec<t_lexeme> convert_lexemes(t_pp_c_iter it, t_pp_c_iter fin);
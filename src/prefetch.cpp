@@ -0,0 +1,171 @@
+#include "prefetch.hpp"
+#include "scan.hpp"
+
+namespace {
+    // the names in the #include lines of a file that are spelled out;
+    // lines in groups that turn out to be skipped are found as well, which
+    // costs no more than a wasted read
+    vec<std::pair<str, bool>> find_includes(str_view s) {
+        _ res = vec<std::pair<str, bool>>();
+        _ i = size_t(0);
+        while (i < s.size()) {
+            _ j = skip_blank_lines(s, i);
+            if (j < s.size() and s[j] == '#') {
+                j = skip_blanks(s, j + 1);
+                _ k = skip_identifier_chars(s, j);
+                _ name = s.substr(j, k - j);
+                j = skip_blanks(s, k);
+                if (name == "include" and j < s.size()
+                    and (s[j] == '"' or s[j] == '<')) {
+                    _ close = (s[j] == '"' ? '"' : '>');
+                    _ end = s.find_first_of(str{close, '\n'}, j + 1);
+                    if (end != str_view::npos and s[end] == close
+                        and end != j + 1) {
+                        res.push_back({str(s.substr(j + 1, end - j - 1)),
+                                       close == '"'});
+                    }
+                }
+            }
+            i = skip_line(s, j);
+        }
+        return res;
+    }
+}
+
+size_t search_include(t_file_manager& file_manager, const vec<str>& dirs,
+                      const str& rel_path) {
+    for (_& dir : dirs) {
+        if (not file_manager.dir_may_contain(dir, rel_path)) {
+            continue;
+        }
+        _ abs_path = dir + "/" + rel_path;
+        _ idx = file_manager.try_read_file(abs_path, rel_path);
+        if (idx != size_t(-1)) {
+            return idx;
+        }
+    }
+    return size_t(-1);
+}
+
+t_prefetcher::t_prefetcher(t_file_manager& file_manager_,
+                           t_lex_cache& lex_cache_,
+                           const vec<str>& system_dirs_)
+    : file_manager(file_manager_)
+    , lex_cache(lex_cache_)
+    , system_dirs(system_dirs_) {
+    // with a single core the workers would only take turns with the
+    // preprocessor
+    _ cores = std::max(1u, std::thread::hardware_concurrency());
+    _ n = std::min(4u, cores - 1);
+    for (_ i = 0u; i < n; i++) {
+        workers.emplace_back([this]() {
+            work();
+        });
+    }
+}
+
+t_prefetcher::~t_prefetcher() {
+    stop();
+}
+
+// the mutex must be held
+void t_prefetcher::push(size_t file_idx) {
+    if (queued.insert(file_idx).second) {
+        queue.push_back(file_idx);
+        work_cv.notify_one();
+    }
+}
+
+void t_prefetcher::work() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_cv.wait(lock, [this]() {
+            return is_stopping or not queue.empty();
+        });
+        if (is_stopping) {
+            return;
+        }
+        _ file_idx = queue.front();
+        queue.pop_front();
+        _ should_lex = (taken.count(file_idx) == 0);
+        if (should_lex) {
+            lexing.insert(file_idx);
+        }
+        lock.unlock();
+
+        if (should_lex) {
+            _ ls = t_pp_seq();
+            _ is_lexed = false;
+            // an error is reported when the preprocessor lexes the file
+            try {
+                ls = lex_cache.lex(file_idx);
+                is_lexed = true;
+            } catch (...) {
+            }
+            lock.lock();
+            lexing.erase(file_idx);
+            if (is_lexed) {
+                lexed.emplace(file_idx, std::move(ls));
+            }
+            done_cv.notify_all();
+            lock.unlock();
+        }
+
+        try {
+            _ dir = get_file_dir(file_manager.get_abs_path(file_idx));
+            _ text = file_manager.get_text(file_idx);
+            for (_& [rel_path, is_quoted] : find_includes(text)) {
+                _ idx = size_t(-1);
+                if (is_quoted) {
+                    idx = search_include(file_manager, {dir}, rel_path);
+                }
+                if (idx == size_t(-1)) {
+                    idx = search_include(file_manager, system_dirs, rel_path);
+                }
+                if (idx != size_t(-1)) {
+                    lock.lock();
+                    push(idx);
+                    lock.unlock();
+                }
+            }
+        } catch (...) {
+        }
+    }
+}
+
+// looks for the files included by a file the preprocessor has lexed itself
+void t_prefetcher::scan(size_t file_idx) {
+    std::lock_guard<std::mutex> lock(mutex);
+    taken.insert(file_idx);
+    push(file_idx);
+}
+
+// moves the lexemes of the file into ls if they have been lexed, waiting
+// for them if they are being lexed
+bool t_prefetcher::take(size_t file_idx, t_pp_seq& ls) {
+    std::unique_lock<std::mutex> lock(mutex);
+    taken.insert(file_idx);
+    push(file_idx);
+    done_cv.wait(lock, [&]() {
+        return lexing.count(file_idx) == 0;
+    });
+    _ it = lexed.find(file_idx);
+    if (it == lexed.end()) {
+        return false;
+    }
+    ls = std::move((*it).second);
+    lexed.erase(it);
+    return true;
+}
+
+void t_prefetcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopping = true;
+    }
+    work_cv.notify_all();
+    for (_& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "misc.hpp"
+#include "file.hpp"
+#include "lex.hpp"
+#include "cache.hpp"
+
+size_t search_include(t_file_manager&, const vec<str>& dirs,
+                      const str& rel_path);
+
+// Looks for the #include lines of the files being preprocessed and, on
+// a few worker threads, finds, reads and lexes the files they name before
+// the preprocessor gets to them.  Only a guess: the preprocessor still
+// resolves every #include itself, and lexes the file itself if the guess
+// was wrong or is not ready yet.
+class t_prefetcher {
+    t_file_manager& file_manager;
+    t_lex_cache& lex_cache;
+    const vec<str>& system_dirs;
+    vec<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    bool is_stopping = false;
+    std::deque<size_t> queue;
+    std::unordered_set<size_t> queued;
+    // the preprocessor has asked for these, so they are not lexed here
+    std::unordered_set<size_t> taken;
+    std::unordered_set<size_t> lexing;
+    std::unordered_map<size_t, t_pp_seq> lexed;
+
+    void push(size_t);
+    void work();
+public:
+    t_prefetcher(t_file_manager&, t_lex_cache&, const vec<str>& system_dirs);
+    ~t_prefetcher();
+    void scan(size_t file_idx);
+    bool take(size_t file_idx, t_pp_seq&);
+    void stop();
+};
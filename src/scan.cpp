@@ -0,0 +1,260 @@
+#include <cstdint>
+
+#include "scan.hpp"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define SIMD_SCAN
+
+namespace {
+    using t_chunk = __m256i;
+    const size_t chunk_size = 32;
+    const uint32_t full_mask = 0xffffffff;
+
+    _ load(const char* p) {
+        return _mm256_loadu_si256((const __m256i*)p);
+    }
+    _ splat(char ch) {
+        return _mm256_set1_epi8(ch);
+    }
+    _ eq(t_chunk x, char ch) {
+        return _mm256_cmpeq_epi8(x, splat(ch));
+    }
+    _ either(t_chunk x, t_chunk y) {
+        return _mm256_or_si256(x, y);
+    }
+    _ both(t_chunk x, t_chunk y) {
+        return _mm256_and_si256(x, y);
+    }
+    _ in_range(t_chunk x, char lo, char hi) {
+        _ d = _mm256_sub_epi8(x, splat(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(d, splat(hi - lo)), d);
+    }
+    uint32_t mask(t_chunk x) {
+        return _mm256_movemask_epi8(x);
+    }
+}
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#define SIMD_SCAN
+
+namespace {
+    using t_chunk = __m128i;
+    const size_t chunk_size = 16;
+    const uint32_t full_mask = 0xffff;
+
+    _ load(const char* p) {
+        return _mm_loadu_si128((const __m128i*)p);
+    }
+    _ splat(char ch) {
+        return _mm_set1_epi8(ch);
+    }
+    _ eq(t_chunk x, char ch) {
+        return _mm_cmpeq_epi8(x, splat(ch));
+    }
+    _ either(t_chunk x, t_chunk y) {
+        return _mm_or_si128(x, y);
+    }
+    _ both(t_chunk x, t_chunk y) {
+        return _mm_and_si128(x, y);
+    }
+    _ in_range(t_chunk x, char lo, char hi) {
+        _ d = _mm_sub_epi8(x, splat(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(d, splat(hi - lo)), d);
+    }
+    uint32_t mask(t_chunk x) {
+        return _mm_movemask_epi8(x);
+    }
+}
+
+#endif
+
+namespace {
+    bool is_blank(char ch) {
+        return ch == ' ' or ch == '\t' or ch == '\v' or ch == '\f';
+    }
+
+    bool is_identifier_char(char ch) {
+        return (('a' <= ch and ch <= 'z') or ('A' <= ch and ch <= 'Z')
+                or ('0' <= ch and ch <= '9') or ch == '_');
+    }
+
+#ifdef SIMD_SCAN
+    _ blanks(t_chunk x) {
+        return either(either(eq(x, ' '), eq(x, '\t')),
+                      either(eq(x, '\v'), eq(x, '\f')));
+    }
+
+    _ identifier_chars(t_chunk x) {
+        return either(either(in_range(x, 'a', 'z'), in_range(x, 'A', 'Z')),
+                      either(in_range(x, '0', '9'), eq(x, '_')));
+    }
+#endif
+
+    template <class t_chunk_pred, class t_pred>
+    size_t skip_while(str_view s, size_t i,
+                      [[maybe_unused]] t_chunk_pred chunk_pred, t_pred pred) {
+#ifdef SIMD_SCAN
+        _ p = s.data();
+        while (i + chunk_size <= s.size()) {
+            _ m = ~mask(chunk_pred(load(p + i))) & full_mask;
+            if (m != 0) {
+                return i + __builtin_ctz(m);
+            }
+            i += chunk_size;
+        }
+#endif
+        while (i < s.size() and pred(s[i])) {
+            i++;
+        }
+        return i;
+    }
+}
+
+size_t skip_blanks(str_view s, size_t i) {
+#ifdef SIMD_SCAN
+    return skip_while(s, i, blanks, is_blank);
+#else
+    return skip_while(s, i, 0, is_blank);
+#endif
+}
+
+size_t skip_identifier_chars(str_view s, size_t i) {
+#ifdef SIMD_SCAN
+    return skip_while(s, i, identifier_chars, is_identifier_char);
+#else
+    return skip_while(s, i, 0, is_identifier_char);
+#endif
+}
+
+size_t skip_pp_number_chars(str_view s, size_t i) {
+    _ is_pp_number_char = [](char ch) {
+        return is_identifier_char(ch) or ch == '.';
+    };
+#ifdef SIMD_SCAN
+    _ pp_number_chars = [](t_chunk x) {
+        return either(identifier_chars(x), eq(x, '.'));
+    };
+    return skip_while(s, i, pp_number_chars, is_pp_number_char);
+#else
+    return skip_while(s, i, 0, is_pp_number_char);
+#endif
+}
+
+size_t find_comment_end(str_view s, size_t i) {
+#ifdef SIMD_SCAN
+    _ p = s.data();
+    while (i + chunk_size + 1 <= s.size()) {
+        _ m = mask(both(eq(load(p + i), '*'), eq(load(p + i + 1), '/')));
+        if (m != 0) {
+            return i + __builtin_ctz(m);
+        }
+        i += chunk_size;
+    }
+#endif
+    return s.find("*/", i);
+}
+
+namespace {
+    // a block comment may run on to later lines
+    size_t skip_blanks_and_comments(str_view s, size_t i) {
+        while (true) {
+            i = skip_blanks(s, i);
+            if (s.compare(i, 2, "/*") != 0) {
+                return i;
+            }
+            _ j = find_comment_end(s, i + 2);
+            if (j == str_view::npos) {
+                return s.size();
+            }
+            i = j + 2;
+        }
+    }
+
+    // an unterminated literal ends with the line
+    size_t skip_quoted(str_view s, size_t i) {
+        _ quote = s[i];
+        i++;
+        while (i < s.size() and s[i] != quote and s[i] != '\n') {
+            if (s[i] == '\\' and i + 1 < s.size() and s[i + 1] != '\n') {
+                i++;
+            }
+            i++;
+        }
+        return i < s.size() and s[i] == quote ? i + 1 : i;
+    }
+}
+
+// the offset just past the newline that ends the line, without looking
+// into comments and literals
+size_t skip_line(str_view s, size_t i) {
+    while (true) {
+        i = s.find_first_of("\n/\"'", i);
+        if (i == str_view::npos) {
+            return s.size();
+        }
+        _ ch = s[i];
+        if (ch == '\n') {
+            return i + 1;
+        } else if (ch == '/' and s.compare(i, 2, "/*") == 0) {
+            _ j = find_comment_end(s, i + 2);
+            if (j == str_view::npos) {
+                return s.size();
+            }
+            i = j + 2;
+        } else if (ch == '/' and s.compare(i, 2, "//") == 0) {
+            _ j = s.find('\n', i);
+            return j == str_view::npos ? s.size() : j + 1;
+        } else if (ch == '/') {
+            i++;
+        } else {
+            i = skip_quoted(s, i);
+        }
+    }
+}
+
+size_t skip_blank_lines(str_view s, size_t i) {
+    while (true) {
+        i = skip_blanks_and_comments(s, i);
+        if (i == s.size() or s[i] != '\n') {
+            return i;
+        }
+        i++;
+    }
+}
+
+// skips the lines of a conditional group that is not processed, starting
+// at the beginning of a line, with level groups nested inside it already
+// open. returns the offset of the line with the #elif, #else or #endif that
+// ends the group and sets directive to its name, or returns the size of
+// the text if there is no such line
+size_t skip_group(str_view s, size_t i, int level, str_view& directive) {
+    while (i < s.size()) {
+        _ j = skip_blanks_and_comments(s, i);
+        if (j < s.size() and s[j] == '#') {
+            j = skip_blanks_and_comments(s, j + 1);
+            _ k = skip_identifier_chars(s, j);
+            _ name = s.substr(j, k - j);
+            if (name == "if" or name == "ifdef" or name == "ifndef") {
+                level++;
+            } else if (name == "endif" or name == "elif" or name == "else") {
+                if (level == 0) {
+                    directive = name;
+                    return i;
+                }
+                if (name == "endif") {
+                    level--;
+                }
+            }
+            j = k;
+        }
+        i = skip_line(s, j);
+    }
+    directive = str_view();
+    return s.size();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "misc.hpp"
+
+size_t skip_blanks(str_view, size_t);
+size_t skip_identifier_chars(str_view, size_t);
+size_t skip_pp_number_chars(str_view, size_t);
+size_t find_comment_end(str_view, size_t);
+
+size_t skip_line(str_view, size_t);
+size_t skip_blank_lines(str_view, size_t);
+size_t skip_group(str_view, size_t, int, str_view&);
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#include "stats.hpp"
+
+namespace {
+    _ token_cnt(const t_pp_seq& ls) {
+        _ n = size_t(0);
+        for (_& lx : ls) {
+            _ kind = lx.kind;
+            if (kind != t_kind::whitespace and kind != t_kind::newline
+                and kind != t_kind::eof and kind != t_kind::raw_text
+                and kind != t_kind::placemarker) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    _ json_str(str_view x) {
+        str res = "\"";
+        for (_ ch : x) {
+            if (ch == '\\' or ch == '"') {
+                res += '\\';
+                res += ch;
+            } else if (ch < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                res += buf;
+            } else {
+                res += ch;
+            }
+        }
+        return res + "\"";
+    }
+
+    template <class t_duration>
+    _ ms(t_duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+t_pp_stats::t_pp_stats(const t_file_manager& file_manager_)
+    : file_manager(file_manager_)
+    , last(t_clock::now()) {
+}
+
+void t_pp_stats::charge(t_clock::time_point now) {
+    if (cur_file != size_t(-1)) {
+        files[cur_file].pp_time += now - last;
+    }
+    last = now;
+}
+
+// called before each step, with the location of the lexeme it starts at
+void t_pp_stats::step(t_loc loc) {
+    charge(t_clock::now());
+    if (loc.is_valid()) {
+        cur_file = file_manager.get_file_idx(loc);
+    }
+}
+
+void t_pp_stats::count_include(size_t file_idx) {
+    files[file_idx].include_cnt++;
+}
+
+void t_pp_stats::start_lex() {
+    charge(t_clock::now());
+}
+
+// for lexing done before the preprocessor started
+void t_pp_stats::add_lex(size_t file_idx, const t_pp_seq& ls,
+                         t_clock::duration time) {
+    _& fs = files[file_idx];
+    fs.lex_time += time;
+    fs.token_cnt += token_cnt(ls);
+}
+
+void t_pp_stats::end_lex(size_t file_idx, const t_pp_seq& ls) {
+    _ now = t_clock::now();
+    add_lex(file_idx, ls, now - last);
+    last = now;
+}
+
+// the depth is the number of macros the replacement is nested in, either
+// by rescanning or as an argument, counting the macro itself
+void t_pp_stats::count_expansion(t_id id, const t_pp_seq& replacement,
+                                 t_hide_set hs) {
+    _& m = macros[id];
+    m.expansion_cnt++;
+    m.output_token_cnt += token_cnt(replacement);
+    m.max_depth = std::max(m.max_depth, hide_set_size(hs) + arg_depth);
+}
+
+// the files that took longest and the macros that produced the most
+// tokens come first
+void t_pp_stats::write(const str& path) {
+    charge(t_clock::now());
+    _ file_list = vec<std::pair<size_t, t_file_stats>>(files.begin(),
+                                                       files.end());
+    std::sort(file_list.begin(), file_list.end(), [](_& x, _& y) {
+        return (x.second.lex_time + x.second.pp_time
+                > y.second.lex_time + y.second.pp_time);
+    });
+    _ macro_list = vec<std::pair<t_id, t_macro_stats>>(macros.begin(),
+                                                       macros.end());
+    std::sort(macro_list.begin(), macro_list.end(), [](_& x, _& y) {
+        return (std::make_pair(y.second.output_token_cnt, id_name(x.first))
+                < std::make_pair(x.second.output_token_cnt,
+                                 id_name(y.first)));
+    });
+
+    _ os = std::ofstream(path);
+    if (not os) {
+        throw std::runtime_error("could not open " + path);
+    }
+    os << std::fixed << std::setprecision(3);
+    os << "{\n  \"files\": [";
+    _ sep = "\n";
+    for (_& [file_idx, fs] : file_list) {
+        _ bytes = file_manager.get_file_contents(file_idx).size();
+        os << sep << "    {\"path\": "
+           << json_str(file_manager.get_abs_path(file_idx))
+           << ", \"includes\": " << fs.include_cnt
+           << ", \"bytes\": " << bytes
+           << ", \"tokens\": " << fs.token_cnt
+           << ", \"lex_ms\": " << ms(fs.lex_time)
+           << ", \"pp_ms\": " << ms(fs.pp_time) << "}";
+        sep = ",\n";
+    }
+    os << "\n  ],\n  \"macros\": [";
+    sep = "\n";
+    for (_& [id, m] : macro_list) {
+        os << sep << "    {\"name\": " << json_str(id_name(id))
+           << ", \"expansions\": " << m.expansion_cnt
+           << ", \"output_tokens\": " << m.output_token_cnt
+           << ", \"max_depth\": " << m.max_depth << "}";
+        sep = ",\n";
+    }
+    os << "\n  ]\n}\n";
+    if (not os) {
+        throw std::runtime_error("could not write " + path);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+
+#include "misc.hpp"
+#include "file.hpp"
+#include "lex.hpp"
+
+// What the preprocessor spent its time on, per file and per macro, for
+// finding the headers and macros that make a file slow to compile.  The
+// time between two steps of the preprocessor is charged to the file it
+// was working on, less the time spent finding, reading and lexing an
+// included file, which is charged to that file as lexing.
+class t_pp_stats {
+    using t_clock = std::chrono::steady_clock;
+
+    struct t_file_stats {
+        size_t include_cnt = 0;
+        size_t token_cnt = 0;
+        t_clock::duration lex_time = {};
+        t_clock::duration pp_time = {};
+    };
+
+    struct t_macro_stats {
+        size_t expansion_cnt = 0;
+        size_t output_token_cnt = 0;
+        size_t max_depth = 0;
+    };
+
+    const t_file_manager& file_manager;
+    std::unordered_map<size_t, t_file_stats> files;
+    std::unordered_map<t_id, t_macro_stats> macros;
+    size_t cur_file = size_t(-1);
+    t_clock::time_point last;
+    // the number of macro arguments being expanded
+    size_t arg_depth = 0;
+
+    void charge(t_clock::time_point);
+public:
+    explicit t_pp_stats(const t_file_manager&);
+    void step(t_loc);
+    void count_include(size_t file_idx);
+    void add_lex(size_t file_idx, const t_pp_seq&, t_clock::duration);
+    void start_lex();
+    void end_lex(size_t file_idx, const t_pp_seq&);
+    void count_expansion(t_id, const t_pp_seq& replacement,
+                         t_hide_set);
+    void enter_arg() {
+        arg_depth++;
+    }
+    void leave_arg() {
+        arg_depth--;
+    }
+    void write(const str& path);
+};
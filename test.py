@@ -40,7 +40,7 @@ def test(filename):
     if os.path.isdir(filename):
         for _file in os.listdir(filename):
             test(os.path.join(filename, _file))
-    else:
+    elif filename.endswith(".c"):
         global success_cnt
         global failure_cnt
         msg = filename
@@ -0,0 +1,183 @@
+import subprocess
+from subprocess import PIPE
+from tempfile import TemporaryDirectory
+import os
+import re
+import sys
+import time
+
+# Checks the files the compiler reads and writes besides its input and
+# output: precompiled headers, the lex cache and make rules.  Each check
+# builds its inputs in a temporary directory.  Run it from the repository
+# root.
+
+my_cc = "./build/program"
+
+success_cnt = 0
+failure_cnt = 0
+
+def write(path, text):
+    with open(path, "w") as f:
+        f.write(text)
+
+def run(*args):
+    t = subprocess.run([my_cc, *args], stdout=PIPE, stderr=PIPE)
+    return (t.returncode, t.stdout, t.stderr.decode())
+
+def check(name, success):
+    global success_cnt
+    global failure_cnt
+    msg = name
+    msg += (50 - len(name)) * "."
+    if success:
+        msg += "ok"
+        success_cnt += 1
+    else:
+        msg += "fail"
+        failure_cnt += 1
+    print(msg)
+
+# a header including a guarded header and a system header, and a file
+# using it, once as text and once through the precompiled header
+def write_pch_inputs(d):
+    write(os.path.join(d, "dep.h"),
+          "#ifndef DEP_H\n#define DEP_H\n#define VAL 1\n#endif\n")
+    write(os.path.join(d, "head.h"),
+          "#include <stdio.h>\n#include \"dep.h\"\n#include \"dep.h\"\n"
+          "#define SQ(x) ((x) * (x))\n"
+          "typedef struct { int a; int b; } pair;\n")
+    body = ("int main() {\n    pair p;\n    p.a = SQ(VAL + 2);\n"
+            "    printf(\"%d\\n\", p.a);\n    return 0;\n}\n")
+    write(os.path.join(d, "main.c"), body)
+    write(os.path.join(d, "main_inc.c"), "#include \"head.h\"\n" + body)
+
+def test_pch():
+    with TemporaryDirectory() as d:
+        write_pch_inputs(d)
+        pch = os.path.join(d, "head.pch")
+        main = os.path.join(d, "main.c")
+        main_inc = os.path.join(d, "main_inc.c")
+        dep = os.path.join(d, "dep.h")
+
+        def same_as_include(expect_warning):
+            used = run("--include-pch", pch, "--pre-ast", main)
+            plain = run("--pre-ast", main_inc)
+            has_warning = "is out of date" in used[2]
+            return (used[0] == 0 and used[1] == plain[1]
+                    and has_warning == expect_warning)
+
+        res = run("--emit-pch", "-o", pch, os.path.join(d, "head.h"))
+        check("pch: emit", res[0] == 0 and os.path.exists(pch))
+        check("pch: use", same_as_include(False))
+
+        # a new mtime with the same contents keeps the header valid
+        later = time.time() + 100
+        os.utime(dep, (later, later))
+        check("pch: touched dependency", same_as_include(False))
+
+        write(dep, "#ifndef DEP_H\n#define DEP_H\n#define VAL 5\n#endif\n")
+        check("pch: edited dependency", same_as_include(True))
+
+# included files are cached, lazily lexed groups included
+def write_cache_inputs(d):
+    write(os.path.join(d, "a.h"),
+          "#ifndef A_H\n#define A_H\n#define N 7\n"
+          "#if 0\nint skipped;\n#else\nint a;\n#endif\n#endif\n")
+    write(os.path.join(d, "main.c"),
+          "#include <stdio.h>\n#include \"a.h\"\n"
+          "int main() {\n    printf(\"%d\\n\", N);\n    return 0;\n}\n")
+
+def test_cache():
+    with TemporaryDirectory() as d:
+        write_cache_inputs(d)
+        cache = os.path.join(d, "cache")
+        main = os.path.join(d, "main.c")
+
+        def same_as_uncached():
+            cached = run("--lex-cache", cache, "--pre-ast", main)
+            plain = run("--pre-ast", main)
+            return cached[0] == 0 and cached[1] == plain[1]
+
+        def entries():
+            return [os.path.join(cache, x) for x in os.listdir(cache)
+                    if x.endswith(".lex")]
+
+        check("cache: cold", same_as_uncached() and len(entries()) > 0)
+        check("cache: warm", same_as_uncached())
+
+        before = run("--pre-ast", main)[1]
+        write(os.path.join(d, "a.h"),
+              "#ifndef A_H\n#define A_H\n#define N 8\nint b;\n#endif\n")
+        check("cache: edited file",
+              same_as_uncached() and run("--pre-ast", main)[1] != before)
+
+        for path in entries():
+            with open(path, "r+b") as f:
+                f.truncate(os.path.getsize(path) // 2)
+        check("cache: truncated entries", same_as_uncached())
+
+        same_as_uncached()
+        for path in entries():
+            with open(path, "r+b") as f:
+                data = bytearray(f.read())
+                for i in range(len(data) * 3 // 4, len(data), 7):
+                    data[i] ^= 0x55
+                f.seek(0)
+                f.write(data)
+        check("cache: damaged entries", same_as_uncached())
+
+# headers with names make has to escape, and headers included twice, the
+# second time skipped by a guard or by #pragma once
+def write_deps_inputs(d):
+    write(os.path.join(d, "a b.h"), "int ab;\n")
+    write(os.path.join(d, "c#d.h"), "int cd;\n")
+    write(os.path.join(d, "e$f.h"), "int ef;\n")
+    write(os.path.join(d, "guard.h"),
+          "#ifndef GUARD_H\n#define GUARD_H\nint g;\n#endif\n")
+    write(os.path.join(d, "once.h"), "#pragma once\nint o;\n")
+    write(os.path.join(d, "main.c"),
+          "#include \"a b.h\"\n#include \"c#d.h\"\n#include \"e$f.h\"\n"
+          "#include \"guard.h\"\n#include \"guard.h\"\n"
+          "#include \"once.h\"\n#include \"once.h\"\n"
+          "int main() {\n    return 0;\n}\n")
+
+def test_deps():
+    with TemporaryDirectory() as d:
+        write_deps_inputs(d)
+        main = os.path.join(d, "main.c")
+        out = os.path.join(d, "out.ll")
+        deps = os.path.join(d, "out.d")
+
+        def quote(path):
+            return (path.replace(" ", "\\ ").replace("#", "\\#")
+                    .replace("$", "$$"))
+        headers = [quote(os.path.join(d, x))
+                   for x in ["a b.h", "c#d.h", "e$f.h", "guard.h", "once.h"]]
+
+        res = run("-MD", "--pre-ast", "-o", out, main)
+        check("deps: -MD", res[0] == 0 and os.path.exists(deps))
+        with open(deps) as f:
+            text = f.read()
+        rule, *phony = text.strip().split("\n\n")
+        # split at the spaces that are not escaped
+        names = re.split(r"(?<!\\) +", rule.replace(" \\\n ", ""))
+        check("deps: target", names[:2] == [out + ":", quote(main)])
+        check("deps: escaped names",
+              all(names.count(x) == 1 for x in headers))
+        check("deps: phony rules",
+              sorted(phony) == sorted(x + ":" for x in headers))
+
+        other = os.path.join(d, "other.d")
+        res = run("-MF", other, "--pre-ast", "-o", out, main)
+        with open(other) as f:
+            check("deps: -MF", res[0] == 0 and f.read() == text)
+
+try:
+    test_pch()
+    test_cache()
+    test_deps()
+    print("===================summary==========================")
+    print(f"{success_cnt} successes, {failure_cnt} failures")
+    sys.exit(1 if failure_cnt else 0)
+except KeyboardInterrupt:
+    sys.exit(0)
@@ -0,0 +1,14 @@
+/* a comment before the guard */
+#ifndef GUARD_H
+#define GUARD_H
+
+int guard_val(void) {
+    return 2;
+}
+
+#if 0
+it's skipped "here too
+#else
+#endif
+
+#endif
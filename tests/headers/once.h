@@ -0,0 +1,5 @@
+#pragma once
+
+int once_val(void) {
+    return 1;
+}
@@ -0,0 +1,8 @@
+#ifndef REGUARD_H
+#define REGUARD_H
+
+int NAME(void) {
+    return VAL;
+}
+
+#endif
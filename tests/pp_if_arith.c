@@ -0,0 +1,99 @@
+#include <stdio.h>
+
+#define pr(y) printf("%d\n", y)
+
+int main() {
+#if -1 > 0u
+    pr(1);
+#else
+    pr(2);
+#endif
+
+#if (1 ? -1 : 0u) > 0
+    pr(3);
+#else
+    pr(4);
+#endif
+
+#if (0 ? 0u : -1) > 0
+    pr(5);
+#endif
+
+#if (1 ? -1 : 0) < 0
+    pr(6);
+#endif
+
+#if 0 && 1 / 0
+    pr(7);
+#else
+    pr(8);
+#endif
+
+#if 1 || 1 % 0
+    pr(9);
+#endif
+
+#if 0 ? 1 / 0 : 10
+    pr(10);
+#endif
+
+#if -1 >> 1 == -1
+    pr(11);
+#endif
+
+#if (-1) / 2 == 0
+    pr(12);
+#endif
+
+#if -1 % 2 == -1
+    pr(13);
+#endif
+
+#if 7 / -2 == -3 && 7 % -2 == 1
+    pr(14);
+#endif
+
+#if 1u - 2 > 0 && 0 - 1u == 0xffffffffffffffff
+    pr(15);
+#endif
+
+#if 0xffffffffffffffff == -1
+    pr(16);
+#endif
+
+#if 10L + 10UL + 10lu + 10U == 40 && 010 == 8
+    pr(17);
+#endif
+
+#if -1L < 0 && -1UL > 0
+    pr(18);
+#endif
+
+#if 'a' == 97 && '\n' == 10 && '\x41' == 65 && '\101' == 65
+    pr(19);
+#endif
+
+#if '\0' == 0 && '\\' == 92 && '\'' == 39
+    pr(20);
+#endif
+
+#if ~0u > 0 && ~0 == -1 && !0u == 1
+    pr(21);
+#endif
+
+#if (2 || 0) == 1 && (2 && 3) == 1
+    pr(22);
+#endif
+
+#if (0, 1) && (1 ? 0, 2 : 0) == 2 && (0u, -1) < 0
+    pr(23);
+#endif
+
+#if 'ab' == 24930 && 'abcd' == 0x61626364 && '\377' < 0 && '\377\377' > 0
+    pr(24);
+#endif
+
+#if '\0a' == 'a' && 'a\0' == 0x6100
+    pr(25);
+#endif
+}
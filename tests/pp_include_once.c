@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+#include "headers/once.h"
+#include "headers/guard.h"
+#include "headers/once.h"
+#include "headers/guard.h"
+
+#define NAME first
+#define VAL 3
+#include "headers/reguard.h"
+#undef NAME
+#undef VAL
+#define NAME second
+#define VAL 4
+#include "headers/reguard.h"
+#undef REGUARD_H
+#include "headers/reguard.h"
+
+int main() {
+    printf("%d\n", once_val());
+    printf("%d\n", guard_val());
+    printf("%d\n", first());
+    printf("%d\n", second());
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#define pr(y) printf("%d\n", y)
+
+int main() {
+#if 0
+    it's not C
+    "an unterminated string
+    /* a comment with
+#endif
+       in it */
+#if 1
+    pr(1);
+#elif 1
+    pr(2);
+#else
+    pr(3);
+#endif
+    pr(4);
+#elif 0
+    pr(5);
+#else
+    pr(6);
+#endif
+
+#if 1
+    pr(7);
+#elif 1 / 0
+    don't
+#else
+#if 1
+    pr(8);
+#endif
+#endif
+
+#ifdef undefined_macro
+    /* #else */ pr(9);
+#  else
+    pr(10);
+#  endif
+
+#ifndef undefined_macro
+    pr(11);
+#elif '"'
+    "
+#endif
+}